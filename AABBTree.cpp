@@ -0,0 +1,236 @@
+#include <algorithm>
+#include <cassert>
+
+#include "AABBTree.h"
+
+int AABBTree::createProxy(const AABB& box, void* userData) {
+	int proxy = allocateNode();
+
+	nodes[proxy].box.min = box.min - glm::vec3(MARGIN);
+	nodes[proxy].box.max = box.max + glm::vec3(MARGIN);
+	nodes[proxy].userData = userData;
+	nodes[proxy].height = 0;
+
+	insertLeaf(proxy);
+	proxyCount++;
+	return proxy;
+}
+
+void AABBTree::destroyProxy(int proxy) {
+	assert(nodes[proxy].isLeaf());
+
+	removeLeaf(proxy);
+	freeNode(proxy);
+	proxyCount--;
+}
+
+bool AABBTree::moveProxy(int proxy, const AABB& box) {
+	assert(nodes[proxy].isLeaf());
+
+	if (contains(nodes[proxy].box, box))
+		return false;
+
+	removeLeaf(proxy);
+	nodes[proxy].box.min = box.min - glm::vec3(MARGIN);
+	nodes[proxy].box.max = box.max + glm::vec3(MARGIN);
+	insertLeaf(proxy);
+	return true;
+}
+
+void AABBTree::clear() {
+	nodes.clear();
+	root = NULL_NODE;
+	freeList = NULL_NODE;
+	proxyCount = 0;
+}
+
+int AABBTree::allocateNode() {
+	if (freeList == NULL_NODE) {
+		nodes.emplace_back();
+		return static_cast<int>(nodes.size()) - 1;
+	}
+
+	int node = freeList;
+	freeList = nodes[node].parent;
+	nodes[node] = Node{};
+	return node;
+}
+
+void AABBTree::freeNode(int node) {
+	nodes[node].parent = freeList;
+	nodes[node].height = -1;
+	nodes[node].userData = nullptr;
+	freeList = node;
+}
+
+void AABBTree::insertLeaf(int leaf) {
+	if (root == NULL_NODE) {
+		root = leaf;
+		nodes[root].parent = NULL_NODE;
+		return;
+	}
+
+	// find the best sibling by the surface area heuristic
+	AABB leafBox = nodes[leaf].box;
+	int index = root;
+	while (!nodes[index].isLeaf()) {
+		int child1 = nodes[index].child1;
+		int child2 = nodes[index].child2;
+
+		float nodeArea = area(nodes[index].box);
+		float combinedArea = area(combine(nodes[index].box, leafBox));
+
+		// cost of creating a new parent for this node and the new leaf
+		float cost = 2.0f * combinedArea;
+		// minimum cost of pushing the leaf further down the tree
+		float inheritanceCost = 2.0f * (combinedArea - nodeArea);
+
+		auto descendCost = [&](int child) {
+			float newArea = area(combine(leafBox, nodes[child].box));
+			if (nodes[child].isLeaf())
+				return newArea + inheritanceCost;
+			return newArea - area(nodes[child].box) + inheritanceCost;
+		};
+
+		float cost1 = descendCost(child1);
+		float cost2 = descendCost(child2);
+
+		if (cost < cost1 && cost < cost2)
+			break;
+
+		index = cost1 < cost2 ? child1 : child2;
+	}
+
+	int sibling = index;
+	int oldParent = nodes[sibling].parent;
+	int newParent = allocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].box = combine(leafBox, nodes[sibling].box);
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	if (oldParent != NULL_NODE) {
+		if (nodes[oldParent].child1 == sibling)
+			nodes[oldParent].child1 = newParent;
+		else
+			nodes[oldParent].child2 = newParent;
+	}
+	else {
+		root = newParent;
+	}
+
+	// walk back up fixing heights and boxes
+	index = nodes[leaf].parent;
+	while (index != NULL_NODE) {
+		index = balance(index);
+
+		int child1 = nodes[index].child1;
+		int child2 = nodes[index].child2;
+		nodes[index].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+		nodes[index].box = combine(nodes[child1].box, nodes[child2].box);
+
+		index = nodes[index].parent;
+	}
+}
+
+void AABBTree::removeLeaf(int leaf) {
+	if (leaf == root) {
+		root = NULL_NODE;
+		return;
+	}
+
+	int parent = nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+	if (grandParent == NULL_NODE) {
+		root = sibling;
+		nodes[sibling].parent = NULL_NODE;
+		freeNode(parent);
+		return;
+	}
+
+	// replace the parent by the sibling
+	if (nodes[grandParent].child1 == parent)
+		nodes[grandParent].child1 = sibling;
+	else
+		nodes[grandParent].child2 = sibling;
+	nodes[sibling].parent = grandParent;
+	freeNode(parent);
+
+	int index = grandParent;
+	while (index != NULL_NODE) {
+		index = balance(index);
+
+		int child1 = nodes[index].child1;
+		int child2 = nodes[index].child2;
+		nodes[index].box = combine(nodes[child1].box, nodes[child2].box);
+		nodes[index].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+
+		index = nodes[index].parent;
+	}
+}
+
+// rotates a subtree when the heights of its children differ by more than one, returns the new subtree root
+int AABBTree::balance(int iA) {
+	Node& A = nodes[iA];
+	if (A.isLeaf() || A.height < 2)
+		return iA;
+
+	int iB = A.child1;
+	int iC = A.child2;
+	int heightDiff = nodes[iC].height - nodes[iB].height;
+
+	// rotate C up or B up, symmetric cases
+	auto rotate = [&](int iUp, int iOther, bool upIsChild2) -> int {
+		Node& up = nodes[iUp];
+		int iF = up.child1;
+		int iG = up.child2;
+
+		// swap A and the raised child
+		up.child1 = iA;
+		up.parent = A.parent;
+		A.parent = iUp;
+
+		if (up.parent != NULL_NODE) {
+			if (nodes[up.parent].child1 == iA)
+				nodes[up.parent].child1 = iUp;
+			else
+				nodes[up.parent].child2 = iUp;
+		}
+		else {
+			root = iUp;
+		}
+
+		// the taller grandchild stays under the raised node, the other one moves to A
+		int iKeep = iF, iMove = iG;
+		if (nodes[iF].height <= nodes[iG].height) {
+			iKeep = iG;
+			iMove = iF;
+		}
+
+		up.child2 = iKeep;
+		if (upIsChild2)
+			A.child2 = iMove;
+		else
+			A.child1 = iMove;
+		nodes[iMove].parent = iA;
+
+		A.box = combine(nodes[iOther].box, nodes[iMove].box);
+		up.box = combine(A.box, nodes[iKeep].box);
+		A.height = 1 + std::max(nodes[iOther].height, nodes[iMove].height);
+		up.height = 1 + std::max(A.height, nodes[iKeep].height);
+
+		return iUp;
+	};
+
+	if (heightDiff > 1)
+		return rotate(iC, iB, true);
+	if (heightDiff < -1)
+		return rotate(iB, iC, false);
+
+	return iA;
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+
+// Dynamic AABB tree (as in Box2D). Leaves store fattened boxes, so small movements
+// do not touch the tree at all and bigger ones are a remove + reinsert with rotations.
+class AABBTree {
+public:
+	static constexpr int NULL_NODE = -1;
+	static constexpr float MARGIN = 0.1f;
+
+	int createProxy(const AABB& box, void* userData);
+	void destroyProxy(int proxy);
+
+	// false when the proxy still fits into its fat box and nothing changed
+	bool moveProxy(int proxy, const AABB& box);
+
+	void* getUserData(int proxy) const { return nodes[proxy].userData; }
+	const AABB& getFatAABB(int proxy) const { return nodes[proxy].box; }
+
+	int getHeight() const { return root == NULL_NODE ? 0 : nodes[root].height; }
+	size_t getProxyCount() const { return proxyCount; }
+
+	// callback(int proxy) -> bool, return false to stop the query
+	template<class Callback>
+	void query(const AABB& box, Callback&& callback) const;
+
+	// callback(int proxy, float maxDistance) -> float, returns the new max distance
+	// (the hit distance to clip the ray, maxDistance to ignore the proxy, 0 to stop)
+	template<class Callback>
+	void raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Callback&& callback) const;
+
+	void clear();
+
+private:
+	struct Node {
+		AABB box;
+		void* userData = nullptr;
+		int parent = NULL_NODE; // next free node when in the free list
+		int child1 = NULL_NODE;
+		int child2 = NULL_NODE;
+		int height = -1; // leaf = 0, free = -1
+
+		bool isLeaf() const { return child1 == NULL_NODE; }
+	};
+
+	// traversal stack, heap allocation only for very deep trees
+	class Stack {
+	public:
+		void push(int value) {
+			if (count < INLINE_SIZE)
+				buffer[count] = value;
+			else
+				overflow.push_back(value);
+			count++;
+		}
+		int pop() {
+			count--;
+			if (count < INLINE_SIZE)
+				return buffer[count];
+			int value = overflow.back();
+			overflow.pop_back();
+			return value;
+		}
+		bool empty() const { return count == 0; }
+
+	private:
+		static constexpr int INLINE_SIZE = 64;
+		int buffer[INLINE_SIZE];
+		std::vector<int> overflow;
+		int count = 0;
+	};
+
+	std::vector<Node> nodes;
+	int root = NULL_NODE;
+	int freeList = NULL_NODE;
+	size_t proxyCount = 0;
+
+	int allocateNode();
+	void freeNode(int node);
+	void insertLeaf(int leaf);
+	void removeLeaf(int leaf);
+	int balance(int node);
+
+	static bool overlaps(const AABB& a, const AABB& b) {
+		return a.min.x <= b.max.x && a.max.x >= b.min.x
+			&& a.min.y <= b.max.y && a.max.y >= b.min.y
+			&& a.min.z <= b.max.z && a.max.z >= b.min.z;
+	}
+
+	static bool contains(const AABB& outer, const AABB& inner) {
+		return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z
+			&& outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+	}
+
+	static AABB combine(const AABB& a, const AABB& b) {
+		AABB box;
+		box.min = glm::min(a.min, b.min);
+		box.max = glm::max(a.max, b.max);
+		return box;
+	}
+
+	static float area(const AABB& box) {
+		glm::vec3 d = box.max - box.min;
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+};
+
+template<class Callback>
+void AABBTree::query(const AABB& box, Callback&& callback) const {
+	if (root == NULL_NODE)
+		return;
+
+	Stack stack;
+	stack.push(root);
+
+	while (!stack.empty()) {
+		int nodeId = stack.pop();
+		const Node& node = nodes[nodeId];
+
+		if (!overlaps(node.box, box))
+			continue;
+
+		if (node.isLeaf()) {
+			if (!callback(nodeId))
+				return;
+		}
+		else {
+			stack.push(node.child1);
+			stack.push(node.child2);
+		}
+	}
+}
+
+template<class Callback>
+void AABBTree::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Callback&& callback) const {
+	if (root == NULL_NODE)
+		return;
+
+	// division by zero gives +-inf, which the slab test handles
+	glm::vec3 invDirection = 1.0f / direction;
+
+	Stack stack;
+	stack.push(root);
+
+	while (!stack.empty()) {
+		int nodeId = stack.pop();
+		const Node& node = nodes[nodeId];
+
+		glm::vec3 t1 = (node.box.min - origin) * invDirection;
+		glm::vec3 t2 = (node.box.max - origin) * invDirection;
+		glm::vec3 tMin = glm::min(t1, t2);
+		glm::vec3 tMax = glm::max(t1, t2);
+		float enter = std::fmax(std::fmax(tMin.x, tMin.y), std::fmax(tMin.z, 0.0f));
+		float exit = std::fmin(std::fmin(tMax.x, tMax.y), std::fmin(tMax.z, maxDistance));
+		if (enter > exit)
+			continue;
+
+		if (node.isLeaf()) {
+			maxDistance = callback(nodeId, maxDistance);
+			if (maxDistance <= 0.0f)
+				return;
+		}
+		else {
+			stack.push(node.child1);
+			stack.push(node.child2);
+		}
+	}
+}
@@ -3,11 +3,30 @@
 #include "App.h"
 
 
-App::App() : camera(glm::vec3(0.0f, 0.0f, 3.0f)), threadPool(std::thread::hardware_concurrency()) {
+// short tasks only (asset loading, parallel_for), the camera stages have their own threads
+App::App() : camera(glm::vec3(0.0f, 0.0f, 3.0f)), threadPool(std::max(4u, std::thread::hardware_concurrency())), assetLoader(threadPool), redDetector(&threadPool), jpegEncoder(&threadPool) {
 	//cout << "OpenCV: " << CV_VERSION << endl;
 }
 
+void App::parseArguments(int argc, char* argv[]) {
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--stream") {
+			streamPipeline = true;
+		} else if (arg == "--verify-red-detector") {
+			verifyRedDetector = true;
+		} else if (arg.rfind("--codec=", 0) == 0) {
+			streamCodecName = arg.substr(8);
+		} else if (arg.rfind("--psnr=", 0) == 0) {
+			streamTargetPsnr = std::atof(arg.c_str() + 7);
+		} else {
+			std::cerr << "Unknown argument: " << arg << '\n';
+		}
+	}
+}
+
 void App::init(void) {
+	initialized = true;
 	try {
 		std::cout << "Current working directory: " << std::filesystem::current_path().generic_string() << '\n';
 
@@ -30,11 +49,12 @@ void App::init(void) {
 
 		glfwSwapInterval(isVsyncOn ? 1 : 0);	// Enable/disable VSync
 
+		// models are loaded in the background, the window can be shown right away
+		glfwShowWindow(window);
+
 		//initTestTriangle();
 		initAssets();
 
-		glfwShowWindow(window);
-
 		initImgui();
 
 	} catch (const std::exception& e) {
@@ -57,12 +77,30 @@ void App::initOpenCV() {
 			//throw runtime_error("Cannot open camera");
 		}
 
-		threadPool.enqueue(&App::cameraRedThreadFunction, this);
-		threadPool.enqueue(&App::processingRedThreadFunction, this);
-		//threadPool.enqueue(&App::cameraThreadFunction, this);
-		//threadPool.enqueue(&App::processingThreadFunction, this);
-		//threadPool.enqueue(&App::GUIThreadFunction, this);
-		//threadPool.enqueue(&App::encodeThreadFunction, this);
+		if (!streamPipeline) {
+			cameraThreads.emplace_back(&App::cameraRedThreadFunction, this);
+			cameraThreads.emplace_back(&App::processingRedThreadFunction, this);
+			return;
+		}
+
+		if (streamCodecName == "png") {
+			streamCodec = std::make_unique<PngCodec>();
+		} else if (streamCodecName == "raw") {
+			streamCodec = std::make_unique<RawCodec>();
+		} else {
+			if (streamCodecName != "jpeg")
+				std::cerr << "Unknown codec " << streamCodecName << ", using jpeg\n";
+			auto jpeg = std::make_unique<JpegCodec>(jpegEncoder, 0.5);
+			jpeg->targetPsnr = streamTargetPsnr;
+			streamCodec = std::move(jpeg);
+		}
+		std::cout << "Streaming camera frames with " << streamCodec->name() << '\n';
+
+		cameraThreads.emplace_back(&App::cameraThreadFunction, this);
+		cameraThreads.emplace_back(&App::processingThreadFunction, this);
+		cameraThreads.emplace_back(&App::encodeThreadFunction, this);
+		cameraThreads.emplace_back(&App::decodeThreadFunction, this);
+		cameraThreads.emplace_back(&App::GUIThreadFunction, this);
 	} catch (const std::exception& e) {
 		std::cerr << "OpenCV init failed: " << e.what() << std::endl;
 		throw;
@@ -157,8 +195,13 @@ void App::initAssets() {
 	ShaderProgram modelShader("modelVS.glsl", "modelFS.glsl");
 	shaders.push_back(std::move(modelShader));
 
+	// particles are simulated by a compute shader when the driver allows it
+	ParticleSystem::setBackend(ParticleSystem::Backend::Gpu, shaders[0]);
+
+	assetLoader.init();
+
 	// models
-	Model* rabbitModel = new Model("resources/bunny10k_textured.obj", shaders[0], true);
+	Model* rabbitModel = assetLoader.loadModel("resources/bunny10k_textured.obj", shaders[0], true);
 	rabbitModel->origin = glm::vec3(0.0f, 0.0f, 0.0f);
 	rabbitModel->orientation = glm::vec3(0.0f, 0.0f, 0.0f);
 	Entity* rabbit = new Entity(rabbitModel, nullptr, glm::vec3(0.0f, 0.0f, 0.0f));
@@ -172,7 +215,8 @@ void App::initAssets() {
 
 	//Model terrain = Assets::createTerrain(100, 15.f, 0.01f, shaders[0]);
 	//models.push_back(std::move(terrain));
-	TerrainEntity* terrain = new TerrainEntity(100, 15.f, 0.01f, shaders[0]);
+	// chunked, so the size is no longer limited by one mesh drawn at full resolution
+	terrain = new TerrainEntity(1024, 15.f, 0.01f, shaders[0], &threadPool);
 	entities.push_back(terrain);
 
 	Model* cube = new Model(Assets::createCube(2.0f, glm::vec4(0.89f, 0.85f, 0.173f, 1.0f), shaders[0]));
@@ -189,11 +233,11 @@ void App::initAssets() {
 	Entity* sphereEntity = new Entity(sphere, sphereCollider, glm::vec3(10.0f, -2.0f, 2.0f), glm::vec3(1.0f));
 	entities.push_back(sphereEntity);
 
-	Model* sub = new Model("resources/sub.obj", shaders[0], true);
+	Model* sub = assetLoader.loadModel("resources/sub.obj", shaders[0], true);
 	Entity* subEntity = new Entity(sub, nullptr, glm::vec3(10.0f, 20.0f, 10.0f));
 	entities.push_back(subEntity);
 
-	Model* skull = new Model("resources/skull.obj", shaders[0], true);
+	Model* skull = assetLoader.loadModel("resources/skull.obj", shaders[0], true);
 	Entity* skullEntity = new Entity(skull, nullptr, glm::vec3(0.0f, 30.0f, -50.0f));
 	skullEntity->orientation = glm::vec3(-90.0f, 0.0f, 0.0f);
 	entities.push_back(skullEntity);
@@ -210,6 +254,15 @@ void App::initAssets() {
 	Entity* cubeEntity3 = new Entity(cube3, boxCollider3, glm::vec3(10.0f, 0.0f, 23.0f), glm::vec3(2.0f));
 	entities.push_back(cubeEntity3);
 
+	// a continuous source next to the cubes, bursts still come from player collisions
+	ParticleSystem::Emitter fountain;
+	fountain.position = glm::vec3(14.0f, 1.0f, 21.5f);
+	fountain.rate = 200.0f;
+	fountain.minSpeed = 1.0f;
+	fountain.maxSpeed = 3.0f;
+	fountain.color = glm::vec3(1.0f, 0.5f, 0.1f);
+	ParticleSystem::addEmitter(fountain, shaders[0]);
+
 	//sunLight = Assets::createDirectionalLight(glm::vec3(-0.2f, -1.0f, -0.3f), glm::vec4(0.2f, 0.2f, 0.2f, 1.0f), glm::vec4(0.2f, 0.2f, 0.2f, 1.0f), glm::vec4(0.5f, 0.5f, 0.5f, 1.0f));
 	//pointLight = Assets::createPointLight(glm::vec3(0.0f, 20.0f, 0.0f), glm::vec4(0.2f, 0.2f, 0.2f, 1.0f), glm::vec4(0.5f, 0.5f, 0.5f, 1.0f), glm::vec4(1.0f, 1.0f, 1.0f, 1.0f), 1.0f, 0.09f, 0.032f);
 	//spotLight = Assets::createSpotLight(glm::vec3(10.0f, 20.0f, 20.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec4(0.2f, 0.2f, 0.2f, 1.0f), glm::vec4(0.5f, 0.5f, 0.5f, 1.0f), glm::vec4(1.0f, 1.0f, 1.0f, 1.0f), 1.0f, 0.09f, 0.032f, glm::cos(glm::radians(12.5f)), glm::cos(glm::radians(15.0f)));
@@ -269,7 +322,7 @@ void App::initAssets() {
 	lightsBlock.lights[3].cutOff = glm::cos(glm::radians(12.5f));
 	lightsBlock.lights[3].outerCutOff = glm::cos(glm::radians(15.0f));
 
-	player = new Player(shaders[0], glm::vec3(0.0f, 5.0f, 0.0f));
+	player = new Player(shaders[0], terrain, glm::vec3(0.0f, 5.0f, 0.0f));
 	player->affectedByGravity = true;
 	physicsEntities.push_back(player);
 }
@@ -290,6 +343,15 @@ int App::run(void) {
 	glBindBufferBase(GL_UNIFORM_BUFFER, 0, lightsUBO);
 	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
+	glGenBuffers(1, &frameUBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameBlock), nullptr, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 1, frameUBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	gObjectBuffer.init();
+	oitBuffer.init();
+
 	double lastFrameTime = glfwGetTime();
 	double fps_last_displayed = lastFrameTime;
 	int fps_counter_frames = 0;
@@ -304,6 +366,7 @@ int App::run(void) {
 	float cube1Alpha = 0.5f;
 	float cube2Alpha = 0.5f;
 	float audioVolume = 0.2f;
+	bool gpuParticles = ParticleSystem::backend() == ParticleSystem::Backend::Gpu;
 	while (!glfwWindowShouldClose(window)) {
 		double now = glfwGetTime();
 		deltaTime = now - lastFrameTime;
@@ -341,39 +404,67 @@ int App::run(void) {
 		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(LightsBlock), &lightsBlock);
 		glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
-		for (auto& entity : physicsEntities) {
-			entity->update(deltaTime);
+		// fixed physics steps, leftover time is rendered by interpolating between the last two states
+		physicsAccumulator += deltaTime;
+		int substeps = 0;
+		while (physicsAccumulator >= PHYSICS_STEP && substeps < MAX_PHYSICS_SUBSTEPS) {
+			// integrate in parallel, then resolve collisions one by one in a fixed order
+			threadPool.parallel_for(0, physicsEntities.size(), 16, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i) {
+					physicsEntities[i]->storePreviousState();
+					physicsEntities[i]->update(static_cast<float>(PHYSICS_STEP));
+				}
+			});
+			for (auto& entity : physicsEntities) {
+				entity->resolveCollisions(static_cast<float>(PHYSICS_STEP));
+			}
+			physicsAccumulator -= PHYSICS_STEP;
+			substeps++;
 		}
+		// after a long hitch the simulation slows down instead of spiralling
+		if (substeps == MAX_PHYSICS_SUBSTEPS)
+			physicsAccumulator = std::min(physicsAccumulator, PHYSICS_STEP);
+		float physicsAlpha = static_cast<float>(physicsAccumulator / PHYSICS_STEP);
 
-		for (auto& entity : entities) {
-			entity->update(deltaTime);
-		}
+		followPlayer(physicsAlpha);
 
-		for (auto it = ParticleSystem::particles.begin(); it != ParticleSystem::particles.end();) {
-			ParticleEntity* p = *it;
-			p->update(deltaTime);
-			if (p->lifetime <= 0.0f) {
-				delete* it;
-				it = ParticleSystem::particles.erase(it);
-			} else {
-				++it;
-			}
-		}
+		// collider refits are flagged by the workers and applied serially afterwards
+		gCollisionManager.beginDeferredUpdates();
+		threadPool.parallel_for(0, entities.size(), 8, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+				entities[i]->update(deltaTime);
+		});
+		gCollisionManager.commitUpdates();
+
+		ParticleSystem::update(deltaTime, threadPool);
 
 		if (showImgui) {
 			ImGui_ImplOpenGL3_NewFrame();
 			ImGui_ImplGlfw_NewFrame();
 			ImGui::NewFrame();
 			ImGui::SetNextWindowPos(ImVec2(10, 10));
-			ImGui::SetNextWindowSize(ImVec2(250, 220));
+			ImGui::SetNextWindowSize(ImVec2(250, 365));
 			ImGui::Begin("Info", nullptr, ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove);
 			ImGui::Text("V-Sync: %s", isVsyncOn ? "ON" : "OFF");
 			ImGui::Text("FPS: %.1f", FPS);
+			ImGui::Text("Instanced: %zu draws, %zu objects", instanceBatch.getDrawCalls(), instanceBatch.getInstanceCount());
+			ImGui::Text("Loading: %zu models", assetLoader.pending());
+			ImGui::Text("Visible: %zu, culled: %zu", visibleCount, culledCount);
+			if (terrain)
+				ImGui::Text("Terrain: %zu chunks drawn, %zu loaded", terrain->drawnChunks(), terrain->loadedChunks());
 			ImGui::Text("Camera position: %.1f, %.1f, %.1f", camera.position.x, camera.position.y, camera.position.z);
 			ImGui::Text("Red detected: %s", redDetected.load(std::memory_order_relaxed) ? "YES" : "NO");
 			ImGui::SliderFloat("Cube1 alpha", &cube1Alpha, 0.0f, 1.0f);
 			ImGui::SliderFloat("Cube2 alpha", &cube2Alpha, 0.0f, 1.0f);
 			ImGui::SliderFloat("Volume", &audioVolume, 0.0f, 1.0f);
+			ImGui::Checkbox("Order-independent transparency", &orderIndependentTransparency);
+			if (ImGui::Checkbox("GPU particles", &gpuParticles)) {
+				auto backend = gpuParticles ? ParticleSystem::Backend::Gpu : ParticleSystem::Backend::Cpu;
+				gpuParticles = ParticleSystem::setBackend(backend, shaders[0]) && gpuParticles;
+			}
+			bool kalman = trackerKalman.load(std::memory_order_relaxed);
+			if (ImGui::Checkbox("Kalman prediction", &kalman))
+				trackerKalman.store(kalman, std::memory_order_relaxed);
 			ImGui::Text("(press RMB to release mouse)");
 			ImGui::Text("(press I to show/hide info)");
 			ImGui::Text("(press G to detach/attach camera)");
@@ -388,56 +479,97 @@ int App::run(void) {
 
 		//double time_speed = showImgui ? 0.0 : 1.0;
 
+		// finished background loads, at most a few ms of GL uploads per frame
+		assetLoader.update(4.0);
+
+		if (orderIndependentTransparency)
+			oitBuffer.beginScene(windowWidth, windowHeight);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		glm::mat4 projection = camera.getProjectionMatrix((float)windowWidth / (float)windowHeight, 0.01f, 1000.0f);
 		glm::mat4 view = camera.getViewMatrix();
 
-		shaders[0].activate();
-		shaders[0].setUniform("projection", projection);
-		shaders[0].setUniform("view", view);
-		shaders[0].setUniform("viewPos", camera.position);
+		frameBlock.projection = projection;
+		frameBlock.view = view;
+		frameBlock.viewPos = camera.position;
+		frameBlock.ambientOcclusion = 0.2f;
+
+		glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameBlock), &frameBlock);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
+		gObjectBuffer.beginFrame();
 
-		shaders[0].setUniform("ambientOcclusion", 0.2f);
+		shaders[0].activate();
 
 
 		if (player) {
-			player->draw();
+			player->draw(physicsAlpha);
 		}
 		
+		// frustum culling before the opaque/transparent split, the counts are shown next frame
+		Frustum frustum = Frustum::fromMatrix(projection * view);
+		if (terrain) {
+			float projectionScale = windowHeight / (2.0f * std::tan(glm::radians(camera.zoom) * 0.5f));
+			terrain->updateLod(camera.position, frustum, projectionScale);
+		}
+		visibleCount = 0;
+		culledCount = 0;
+
 		for (auto& entity : entities) {
+			if (!frustum.intersects(entity->getWorldBounds())) {
+				culledCount++;
+				continue;
+			}
+			visibleCount++;
+
 			if (entity->transparent)
 				transparentEntities.push_back(entity);
 			else
 				opaqueEntities.push_back(entity);
 		}
 
+		// opaque entities sharing geometry are drawn with one instanced call
+		instanceBatch.resetStats();
 		for (auto& entity : opaqueEntities) {
-			entity->draw();
+			entity->submit(instanceBatch);
 		}
 
-		for (auto& particle : ParticleSystem::particles) {
-			particle->draw();
-		}
+		instanceBatch.flush();
 
-		std::sort(transparentEntities.begin(), transparentEntities.end(),
-			[&](Entity* a, Entity* b) {
-				float distA = glm::distance2(a->position, camera.position);
-				float distB = glm::distance2(b->position, camera.position);
-				return distA > distB; // want farthest first
+		if (orderIndependentTransparency) {
+			// order does not matter, so transparent entities batch like opaque ones, particles fade through it too
+			oitBuffer.beginTransparent(shaders[0]);
+			for (auto& entity : transparentEntities) {
+				entity->submit(instanceBatch);
 			}
-		);
+			instanceBatch.flush();
+			ParticleSystem::draw(frustum, visibleCount, culledCount);
+			oitBuffer.endTransparent(shaders[0]);
+			oitBuffer.endScene();
+		} else {
+			std::sort(transparentEntities.begin(), transparentEntities.end(),
+				[&](Entity* a, Entity* b) {
+					float distA = glm::distance2(a->position, camera.position);
+					float distB = glm::distance2(b->position, camera.position);
+					return distA > distB; // want farthest first
+				}
+			);
 
-		glDepthMask(GL_FALSE);
-		for (auto& entity : transparentEntities) {
-			entity->draw();
+			glDepthMask(GL_FALSE);
+			// the whole particle pool is one more instanced draw
+			ParticleSystem::draw(frustum, visibleCount, culledCount);
+			for (auto& entity : transparentEntities) {
+				entity->draw();
+			}
+			glDepthMask(GL_TRUE);
 		}
-		glDepthMask(GL_TRUE);
 
 		transparentEntities.clear();
 		opaqueEntities.clear();
 
+		gObjectBuffer.endFrame();
+
 
 		if (showImgui) {
 			ImGui::Render();
@@ -491,145 +623,184 @@ void App::processInput(float deltaTime) {
 	}
 
 	if (cameraDetached) {
-		// detached: move the camera directly
+		// detached: move the camera directly, the player must not keep the input of the last attached frame
 		camera.position += direction * camera.movementSpeed * deltaTime * speedMultiplier;
+		if (player) {
+			player->moveAcceleration = glm::vec3(0.0f);
+			player->jumpRequested = false;
+		}
 	} else {
-		// attached: update the players position
+		// attached: the player is moved by the fixed physics steps
 		if (player) {
 			glm::vec3 accel = direction * player->movementAcceleration * speedMultiplier;
 			accel.y = 0.0f;
-			player->velocity += accel * deltaTime;
+			player->moveAcceleration = accel;
 
-			if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) {
-				if (player->isOnGround) {
-					player->velocity.y = player->jumpVelocity;
-					player->isOnGround = false;
-				}
-			}
+			if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
+				player->jumpRequested = true;
+		}
+	}
+}
 
-			float behindDistance = 1.0f;
-			float heightOffset = 0.5f;
+void App::followPlayer(float alpha) {
+	if (cameraDetached || !player)
+		return;
 
-			glm::vec3 headPos = player->getHeadPosition();
-			glm::vec3 behindPos = headPos - camera.front * behindDistance;
-			behindPos.y += heightOffset;
+	float behindDistance = 1.0f;
+	float heightOffset = 0.5f;
 
-			camera.position = behindPos;
-		}
-	}
+	glm::vec3 headPos = player->getHeadPosition(alpha);
+	glm::vec3 behindPos = headPos - camera.front * behindDistance;
+	behindPos.y += heightOffset;
+
+	camera.position = behindPos;
 }
 
 void App::cameraRedThreadFunction() {
-	cv::Mat frame;
 	while (!stopSignal) {
-		videoCapture.read(frame);
-		if (frame.empty() && displayQueue.empty()) {
+		FrameRef frame = framePool.acquire();
+		if (!frame) {
+			// every buffer is still queued or in use, skip this frame
+			videoCapture.grab();
+			continue;
+		}
+
+		videoCapture.read(*frame);
+		if (frame->empty() && displayQueue.empty()) {
 			std::cerr << "Camera disconnected or end of stream.\n";
 			stopSignal = true;
 			break;
 		}
-		frameQueue.push(frame);
+		frameQueue.push(std::move(frame));
 	}
 	frameQueue.stop();
 }
 
 void App::processingRedThreadFunction() {
-	cv::Mat frame;
+	FrameRef frame;
 	while (!stopSignal) {
-		if (frameQueue.pop(frame)) {
-			if (frame.empty()) {
+		if (frameQueue.pop(frame, std::chrono::milliseconds(100))) {
+			if (frame->empty()) {
 				continue;
 			}
-			bool isRed = findRed(frame);
+			bool isRed = redDetector.detect(*frame);
 			// save to atomic
 			redDetected.store(isRed, std::memory_order_relaxed);
+			// back to the pool
+			frame.reset();
 		}
 	}
 }
 
-bool App::findRed(const cv::Mat& img) {
-	cv::Mat hsv;
-	cv::cvtColor(img, hsv, cv::COLOR_BGR2HSV);
-
-	cv::Mat mask1, mask2;
-	cv::inRange(hsv, cv::Scalar(0, 100, 100), cv::Scalar(10, 255, 255), mask1);
-	cv::inRange(hsv, cv::Scalar(170, 100, 100), cv::Scalar(180, 255, 255), mask2);
-
-	cv::Mat redMask = mask1 | mask2;
-	return cv::countNonZero(redMask) > 0;
-}
-
-
 void App::cameraThreadFunction() {
-	cv::Mat frame;
-
+	uint64_t frameId = 0;
 	while (!stopSignal) {
 		auto start = std::chrono::high_resolution_clock::now();
 
-		videoCapture.read(frame);
-		if (frame.empty() && displayQueue.empty()) {
+		FrameRef frame = framePool.acquire();
+		if (!frame) {
+			videoCapture.grab();
+			continue;
+		}
+
+		videoCapture.read(*frame);
+		if (frame->empty() && displayQueue.empty()) {
 			std::cerr << "Camera disconnected or end of stream.\n";
 			stopSignal = true;
 			break;
 		}
-		frameQueue.push(frame);
 
-		displayQueue.push(std::make_tuple(frame, "Original Frame"));
-		encodeQueue.push(frame);
+		TimedFrame timed{ std::move(frame), frameId++, StreamClock::now() };
+
+		// all three stages share the same buffer
+		frameQueue.push(timed.frame);
+		displayQueue.push(std::make_tuple(timed, std::string("Original Frame")));
+		encodeQueue.push(std::move(timed));
 
 		auto end = std::chrono::high_resolution_clock::now();
 		std::chrono::duration<double> elapsed_microseconds = end - start;
 		auto ms = std::chrono::duration_cast<std::chrono::microseconds>(elapsed_microseconds).count() / 1000.0;
 		//cout << "Elapsed time capturing: " << ms << "ms, " << "FPS: " << 1000.0 / ms << endl;
 	}
+	frameQueue.stop();
+	encodeQueue.stop();
 }
 
 void App::encodeThreadFunction() {
-	cv::Mat frame;
+	TimedFrame frame;
 
-	float target_coefficient = 0.5f;
 	while (!stopSignal) {
-		if (encodeQueue.pop(frame)) {
-			if (frame.empty()) {
+		if (encodeQueue.pop(frame, std::chrono::milliseconds(100))) {
+			if (frame.frame->empty()) {
 				continue;
 			}
 
-			auto start = std::chrono::high_resolution_clock::now();
+			StreamPacket packet;
+			packet.frameId = frame.id;
+			packet.captured = frame.captured;
+			try {
+				streamCodec->encode(*frame.frame, packet.payload);
+			} catch (const std::exception& e) {
+				// one bad frame must not end the stream
+				std::cerr << "Stream encode failed: " << e.what() << '\n';
+				streamLatency.recordDrop();
+				continue;
+			}
+			frame.frame.reset();
 
-			auto size_uncompressed = frame.elemSize() * frame.total();
-			auto size_compressed_limit = size_uncompressed * target_coefficient;
-			std::vector<uchar> bytes = lossyLimitBW(frame, size_compressed_limit);
-			//vector<uchar> bytes = lossyLimitQuality(frame, 30.0f);
+			packet.encoded = StreamClock::now();
+			streamLatency.record(StreamStage::Encode, packet.encoded - packet.captured);
+			streamTransport.send(std::move(packet));
+		}
+	}
+	streamTransport.close();
+}
 
-			decodeQueue.push(bytes);
+void App::decodeThreadFunction() {
+	StreamPacket packet;
 
-			auto end = std::chrono::high_resolution_clock::now();
-			std::chrono::duration<double> elapsed_microseconds = end - start;
-			auto ms = std::chrono::duration_cast<std::chrono::microseconds>(elapsed_microseconds).count() / 1000.0;
-			//cout << "Elapsed time encoding: " << ms << "ms, " << "FPS: " << 1000.0 / ms << endl;
+	while (!stopSignal) {
+		if (!streamTransport.receive(packet, std::chrono::milliseconds(100)))
+			continue;
+
+		streamLatency.record(StreamStage::Transport, packet.received - packet.encoded);
+		if (packet.received - packet.captured > MAX_STREAM_LATENCY) {
+			streamLatency.recordDrop();
+			continue;
 		}
+
+		FrameRef frame = framePool.acquire();
+		if (!frame || !streamCodec->decode(packet.payload.data(), packet.payload.size(), *frame))
+			continue;
+
+		TimedFrame timed{ std::move(frame), packet.frameId, packet.captured, StreamClock::now() };
+		streamLatency.record(StreamStage::Decode, timed.decoded - packet.received);
+		displayQueue.push(std::make_tuple(std::move(timed), std::string("Decoded Frame")));
 	}
 }
 
 void App::processingThreadFunction() {
-	cv::Mat frame;
+	FrameRef frame;
 
 	while (!stopSignal) {
-		if (frameQueue.pop(frame)) {
-			if (frame.empty()) {
+		if (frameQueue.pop(frame, std::chrono::milliseconds(100))) {
+			if (frame->empty()) {
 				continue;
 			}
 
 			auto start = std::chrono::high_resolution_clock::now();
 
-			cv::Point2f center = findObject(frame);
-			cv::Point2f center_normalized(center.x / frame.cols, center.y / frame.rows);
-
-			cv::Mat scene_cross;
-			frame.copyTo(scene_cross);
-			drawCrossNormalized(scene_cross, center_normalized, 30);
+			cv::Point2f center = findObject(*frame);
+			cv::Point2f center_normalized(center.x / frame->cols, center.y / frame->rows);
 
-			displayQueue.push(std::make_tuple(scene_cross, "Processed Frame"));
+			// the source is shared with the display and encode stages, draw into a pooled copy
+			FrameRef scene_cross = framePool.acquire();
+			if (scene_cross) {
+				frame->copyTo(*scene_cross);
+				drawCrossNormalized(*scene_cross, center_normalized, 30);
+				displayQueue.push(std::make_tuple(TimedFrame{ std::move(scene_cross) }, std::string("Processed Frame")));
+			}
+			frame.reset();
 
 			auto end = std::chrono::high_resolution_clock::now();
 			std::chrono::duration<double> elapsed_microseconds = end - start;
@@ -640,38 +811,27 @@ void App::processingThreadFunction() {
 }
 
 void App::GUIThreadFunction() {
-	if (!glfwInit()) {
-		std::cerr << "Failed to initialize GLFW\n";
-		stopSignal = true;
-		return;
-	}
-
-	GLFWwindow* window = glfwCreateWindow(640, 480, "OpenGL Window", NULL, NULL);
-	if (!window) {
-		std::cerr << "Failed to create GLFW window\n";
-		glfwTerminate();
-		stopSignal = true;
-		return;
-	}
-
-	glfwMakeContextCurrent(window);
-	glewExperimental = GL_TRUE;
-	glewInit();
-	glfwSwapInterval(1);
-
-	cv::Mat frame;
-	std::tuple<cv::Mat, std::string> display;
+	// HighGUI windows only, GLFW belongs to the main thread
+	std::tuple<TimedFrame, std::string> display;
 	//int target_fps = 15;
 
 	while (!stopSignal) {
-		if (displayQueue.pop(display)) {
-			frame = std::get<0>(display);
-			std::string window_name = std::get<1>(display);
-			if (frame.empty()) {
+		if (displayQueue.pop(display, std::chrono::milliseconds(100))) {
+			TimedFrame& frame = std::get<0>(display);
+			const std::string& window_name = std::get<1>(display);
+			if (frame.frame->empty()) {
 				continue;
 			}
 
-			cv::imshow(window_name, frame);
+			cv::imshow(window_name, *frame.frame);
+			// imshow keeps its own copy
+			frame.frame.reset();
+
+			if (frame.decoded != StreamClock::time_point{}) {
+				auto shown = StreamClock::now();
+				streamLatency.record(StreamStage::Display, shown - frame.decoded);
+				streamLatency.record(StreamStage::EndToEnd, shown - frame.captured);
+			}
 
 			if (cv::pollKey() == 27) {
 				stopSignal = true;
@@ -685,143 +845,23 @@ void App::GUIThreadFunction() {
 }
 
 std::vector<uchar> App::lossyLimitBW(cv::Mat& input_img, size_t size_limit) {
-	std::string suff(".jpg"); // target format
-	if (!cv::haveImageWriter(suff))
-		throw std::runtime_error("Can not compress to format:" + suff);
-
+	// bisects the quality starting from the previous frame, usually two or three encodes
 	std::vector<uchar> bytes;
-	std::vector<int> compression_params;
-
-	// prepare parameters for JPEG compressor
-	// we use only quality, but other parameters are available (progressive, optimization...)
-	std::vector<int> compression_params_template;
-	compression_params_template.push_back(cv::IMWRITE_JPEG_QUALITY);
-
-	std::cout << '[';
-
-	//try step-by-step to decrease quality by 5%, until it fits into limit
-	for (auto i = 100; i > 0; i -= 5) {
-		compression_params = compression_params_template; // reset parameters
-		compression_params.push_back(i);                  // set desired quality
-		std::cout << i << ',';
-
-		// try to encode
-		cv::imencode(suff, input_img, bytes, compression_params);
-
-		// check the size limit
-		if (bytes.size() <= size_limit)
-			break; // ok, done 
-	}
-	std::cout << "]\n";
-
+	jpegEncoder.encodeLimitBW(input_img, size_limit, bytes);
 	return bytes;
 }
 
 std::vector<uchar> App::lossyLimitQuality(cv::Mat& input_img, float target_quality) {
-	std::string suff(".jpg"); // Target format
-	if (!cv::haveImageWriter(suff))
-		throw std::runtime_error("Cannot compress to format: " + suff);
-
-	std::vector<int> compression_params = { cv::IMWRITE_JPEG_QUALITY, 95 };
-
-	std::vector<uchar> best_bytes;
-	int best_quality = -1;
-
-	std::vector<int> qualities(100);
-	std::iota(qualities.begin(), qualities.end(), 1);
-
-	std::vector<std::future<void>> futures;
-	std::mutex mtx;
-
-	auto compress_and_evaluate_task = [&](int quality) {
-		std::vector<uchar> bytes;
-		std::vector<int> params = { cv::IMWRITE_JPEG_QUALITY, quality };
-		cv::imencode(suff, input_img, bytes, params);
-
-		cv::Mat decoded_img = cv::imdecode(bytes, cv::IMREAD_COLOR);
-
-		// Compute PSNR between the original and compressed images
-		double psnr = cv::PSNR(input_img, decoded_img);
-
-		std::cout << "Quality: " << quality << ", PSNR: " << psnr << std::endl;
-
-		// Update best quality if criteria met
-		if (psnr >= target_quality) {
-			std::lock_guard<std::mutex> lock(mtx);
-			if (best_quality == -1 || quality < best_quality) {
-				best_quality = quality;
-				best_bytes = std::move(bytes); // Save the best compressed image
-			}
-		}
-	};
-
-	for (int quality : qualities) {
-		futures.emplace_back(threadPool.enqueue(compress_and_evaluate_task, quality));
-	}
-
-	for (auto& future : futures) {
-		future.get();
-	}
-
-	if (best_quality == -1) {
-		throw std::runtime_error("Cannot achieve target PSNR with available quality settings.");
-	}
-
-	std::cout << "Selected Quality: " << best_quality << std::endl;
-	return best_bytes;
-}
-
-cv::Mat App::threshold(const cv::Mat& img, const double h_low, const double s_low, const double v_low, const double h_hi, const double s_hi, const double v_hi) {
-	cv::Mat img_hsv, img_threshold;
-
-	cv::cvtColor(img, img_hsv, cv::COLOR_BGR2HSV);
-
-	cv::Scalar lower_threshold = cv::Scalar(h_low, s_low, v_low);
-	cv::Scalar upper_threshold = cv::Scalar(h_hi, s_hi, v_hi);
-	cv::inRange(img_hsv, lower_threshold, upper_threshold, img_threshold);
-
-	return img_threshold;
+	// a few parallel encode/decode/PSNR probes around the previous answer instead of all 100 qualities
+	std::vector<uchar> bytes;
+	jpegEncoder.encodeLimitQuality(input_img, target_quality, bytes);
+	return bytes;
 }
 
 cv::Point2f App::findObject(const cv::Mat& img) {
-	// First range for red hue
-	cv::Mat img_threshold1 = threshold(img, 0, 100, 100, 10, 255, 255);
-
-	// Second range for red hue
-	cv::Mat img_threshold2 = threshold(img, 170, 100, 100, 180, 255, 255);
-
-	// Combine both ranges
-	cv::Mat img_threshold;
-	cv::bitwise_or(img_threshold1, img_threshold2, img_threshold);
-
-	// find contours
-	std::vector<std::vector<cv::Point>> contours;
-	std::vector<cv::Vec4i> hierarchy;
-	cv::findContours(img_threshold, contours, hierarchy, cv::RETR_TREE, cv::CHAIN_APPROX_SIMPLE);
-
-	// find the largest contour
-	int largest_area = 0;
-	int largest_contour_index = 0;
-	for (size_t i = 0; i < contours.size(); i++) {
-		double a = cv::contourArea(contours[i], false);
-		if (a > largest_area) {
-			largest_area = a;
-			largest_contour_index = i;
-		}
-	}
-
-	if (contours.empty())
-		return cv::Point2f(0, 0);
-
-	// find the center of the largest contour
-	cv::Moments mu = cv::moments(contours[largest_contour_index]);
-	cv::Point2f center(mu.m10 / mu.m00, mu.m01 / mu.m00);
-
-	// if center nan, return (0,0)
-	if (center.x != center.x || center.y != center.y)
-		return cv::Point2f(0, 0);
-
-	return center;
+	// searches around the last position, the whole frame only when the object was lost
+	objectTracker.useKalman = trackerKalman.load(std::memory_order_relaxed);
+	return objectTracker.update(img);
 }
 
 void App::drawCross(cv::Mat& img, int x, int y, int size) {
@@ -918,11 +958,27 @@ void App::printInfoGL() {
 
 void App::destroy(void) {
 	stopSignal = true;
-	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	frameQueue.stop();
+	encodeQueue.stop();
+	displayQueue.stop();
+	streamTransport.close();
+	// every stage waits with a timeout, so they notice the signal quickly
+	for (auto& thread : cameraThreads)
+		thread.join();
+	cameraThreads.clear();
 	frameQueue.clear();
 	displayQueue.clear();
 	encodeQueue.clear();
-	decodeQueue.clear();
+
+	if (streamLatency.percentiles(StreamStage::EndToEnd).samples > 0)
+		std::cout << streamLatency.report();
+	// the encode thread is joined, its encoder can be read
+	std::cout << jpegEncoder.report();
+
+	// nothing below exists when init() never ran, e.g. with --verify-red-detector
+	if (!initialized)
+		return;
+	initialized = false;
 
 	// clean up ImGUI
 	ImGui_ImplOpenGL3_Shutdown();
@@ -934,6 +990,10 @@ void App::destroy(void) {
 	if (videoCapture.isOpened())
 		videoCapture.release();
 
+	assetLoader.destroy();
+	gObjectBuffer.destroy();
+	oitBuffer.destroy();
+
 	// clean-up GLFW
 	if (window) {
 		glfwDestroyWindow(window);
@@ -949,6 +1009,9 @@ void App::destroy(void) {
 		delete entity;
 	}
 
+	ParticleSystem::destroy();
+	gAssetCache.clear();
+
 	gAudioPlayer.cleanFinishedSounds();
 }
 
@@ -28,7 +28,14 @@
 #include <backends/imgui_impl_glfw.h>
 #include <backends/imgui_impl_opengl3.h>
 
-#include "ThreadSafeQueue.h"
+#include "BoundedQueue.h"
+#include "FramePool.h"
+#include "RedDetector.h"
+#include "ObjectTracker.h"
+#include "JpegEncoder.h"
+#include "StreamCodec.h"
+#include "StreamTransport.h"
+#include "LatencyStats.h"
 #include "ThreadPool.h"
 #include "Assets.h"
 #include "ShaderProgram.h"
@@ -40,8 +47,13 @@
 #include "TerrainEntity.h"
 #include "PhysicsEntity.h"
 #include "Light.h"
+#include "RenderBlocks.h"
+#include "ObjectBuffer.h"
+#include "OitBuffer.h"
 #include "AudioPlayer.h"
-#include "ParticleEntity.h"
+#include "ParticleSystem.h"
+#include "InstanceBatch.h"
+#include "AssetLoader.h"
 
 
 class App {
@@ -49,11 +61,16 @@ public:
 	App();
 	~App();
 
+	// before init()
+	void parseArguments(int argc, char* argv[]);
 	void init();
 	void initImgui();
 	int run();
 	void destroy();
 
+	// --verify-red-detector: compare RedDetector with cvtColor + inRange for all 2^24 colours instead of starting
+	bool verifyRedDetector = false;
+
 private:
 	// OpenGL
 	GLFWwindow* window = nullptr;
@@ -66,34 +83,69 @@ private:
 	bool isVsyncOn = true;
 	bool fullscreen = false;
 	GLuint lightsUBO;
+	GLuint frameUBO;
 
 	std::atomic<bool> redDetected{ false };
 
 	bool showImgui = true;
 	float deltaTime = 0.0f;
 
+	// physics runs in fixed steps independent of the frame rate
+	static constexpr double PHYSICS_STEP = 1.0 / 120.0;
+	static constexpr int MAX_PHYSICS_SUBSTEPS = 8;
+	double physicsAccumulator = 0.0;
+
 	Player* player = nullptr;
+	TerrainEntity* terrain = nullptr;    // also in entities
 
 	Camera camera;
 	bool cameraDetached = false;
 
 	LightsBlock lightsBlock;
+	FrameBlock frameBlock;
 	
 	std::vector<ShaderProgram> shaders;
 	std::vector<Entity*> transparentEntities;
 	std::vector<Entity*> opaqueEntities;
 	std::vector<Entity*> entities;
 	std::vector<PhysicsEntity*> physicsEntities;
+	InstanceBatch instanceBatch;
+	// weighted blended transparency, otherwise transparent entities are sorted back to front
+	OitBuffer oitBuffer;
+	bool orderIndependentTransparency = true;
+	size_t visibleCount = 0;
+	size_t culledCount = 0;
 
 	cv::VideoCapture videoCapture;
-	ThreadSafeQueue<cv::Mat> frameQueue;
-	ThreadSafeQueue<std::tuple<cv::Mat, std::string>> displayQueue;
-	ThreadSafeQueue<cv::Mat> encodeQueue;
-	ThreadSafeQueue<std::vector<uchar>> decodeQueue;
+	// every captured and processed frame lives in here, the stages only pass handles around
+	FramePool framePool{ 16 };
+	// camera -> processing, only the newest frame is kept so memory stays constant and processing never lags
+	BoundedQueue<FrameRef> frameQueue{ 2, OverflowPolicy::KeepLatest };
+	BoundedQueue<std::tuple<TimedFrame, std::string>> displayQueue{ 4, OverflowPolicy::DropOldest };
+	BoundedQueue<TimedFrame> encodeQueue{ 2, OverflowPolicy::KeepLatest };
+
+	// the camera feeds either the red detector (default) or, with --stream, the processing and
+	// encode -> transport -> decode -> display stages. --codec=jpeg|png|raw, --psnr=<dB> for jpeg
+	bool streamPipeline = false;
+	std::string streamCodecName = "jpeg";
+	double streamTargetPsnr = 0.0;
+
+	// encode -> transport -> decode -> display
+	std::unique_ptr<FrameCodec> streamCodec;
+	LoopbackTransport streamTransport;
+	LatencyStats streamLatency;
+	// decoded frames older than this are not shown, bounds the glass-to-glass latency
+	static constexpr std::chrono::milliseconds MAX_STREAM_LATENCY{ 150 };
 
 	// Threading
 	ThreadPool threadPool;
-	bool stopSignal = false;
+	AssetLoader assetLoader;
+	RedDetector redDetector;
+	// the camera stage loops run for the whole session, each gets its own thread instead of a pool worker
+	std::vector<std::thread> cameraThreads;
+	std::atomic<bool> stopSignal{ false };
+	// set by init(), destroy() only tears down GL, ImGui and GLFW after it
+	bool initialized = false;
 
 	// Init
 	void initOpenCV();
@@ -108,11 +160,17 @@ private:
 	void printInfoGL();
 
 	void processInput(float deltaTime);
+	void followPlayer(float alpha);
 
 	void drawCross(cv::Mat& img, int x, int y, int size);
 	void drawCrossNormalized(cv::Mat& img, const cv::Point2f center_normalized, const int size);
+	// processing thread only
+	ObjectTracker objectTracker;
+	// set from the Info window, copied into objectTracker before every update
+	std::atomic<bool> trackerKalman{ false };
 	cv::Point2f findObject(const cv::Mat& img);
-	cv::Mat threshold(const cv::Mat& img, const double h_low, const double s_low, const double v_low, const double h_hi, const double s_hi, const double v_hi);
+	// encode thread only
+	JpegEncoder jpegEncoder;
 	std::vector<uchar> lossyLimitBW(cv::Mat& input_img, size_t size_limit);
 	std::vector<uchar> lossyLimitQuality(cv::Mat& input_img, float target_quality);
 
@@ -122,7 +180,6 @@ private:
 	void encodeThreadFunction();
 	void decodeThreadFunction();
 
-	bool findRed(const cv::Mat& img);
 	void cameraRedThreadFunction();
 	void processingRedThreadFunction();
 
@@ -0,0 +1,103 @@
+#include "AssetCache.h"
+#include "Model.h"
+
+#include <cstdint>
+
+AssetCache gAssetCache;
+
+AssetCache::AssetCache() = default;
+
+AssetCache::~AssetCache() = default;
+
+std::string AssetCache::shaderKey(const std::string& key, const ShaderProgram& shader) {
+	// meshes keep a reference to their shader, so the same asset with another shader is another entry
+	return key + '@' + std::to_string(reinterpret_cast<std::uintptr_t>(&shader));
+}
+
+std::string AssetCache::modelKey(const std::filesystem::path& path, bool flipTextureYAxis) {
+	return std::filesystem::absolute(path).lexically_normal().generic_string() + (flipTextureYAxis ? ":flip" : "");
+}
+
+std::string AssetCache::textureKey(const std::filesystem::path& path, bool flipYAxis) {
+	return std::filesystem::absolute(path).lexically_normal().generic_string() + (flipYAxis ? ":flip" : "");
+}
+
+Model AssetCache::getModel(const std::filesystem::path& path, ShaderProgram& shader, bool flipTextureYAxis) {
+	return getProcedural(modelKey(path, flipTextureYAxis), shader, [&]() { return Model(path, shader, flipTextureYAxis); });
+}
+
+Model AssetCache::getProcedural(const std::string& key, ShaderProgram& shader, const std::function<Model()>& factory) {
+	std::string fullKey = shaderKey(key, shader);
+
+	auto it = models.find(fullKey);
+	if (it == models.end())
+		it = models.emplace(fullKey, std::make_unique<Model>(factory())).first;
+
+	return *it->second;
+}
+
+std::shared_ptr<Texture> AssetCache::getTexture(const std::filesystem::path& path, bool flipYAxis) {
+	std::string key = textureKey(path, flipYAxis);
+
+	auto it = textures.find(key);
+	if (it != textures.end())
+		return it->second;
+
+	GLuint id = loadTextureFromFile(path.string(), flipYAxis);
+	if (id == 0)
+		return nullptr;
+
+	auto texture = std::make_shared<Texture>(id);
+	textures.emplace(key, texture);
+	return texture;
+}
+
+const Model* AssetCache::findModel(const std::string& key, const ShaderProgram& shader) const {
+	auto it = models.find(shaderKey(key, shader));
+	return it != models.end() ? it->second.get() : nullptr;
+}
+
+Model AssetCache::addModel(const std::string& key, ShaderProgram& shader, Model&& model) {
+	auto& entry = models[shaderKey(key, shader)];
+	entry = std::make_unique<Model>(std::move(model));
+	return *entry;
+}
+
+std::shared_ptr<Texture> AssetCache::findTexture(const std::filesystem::path& path, bool flipYAxis) const {
+	auto it = textures.find(textureKey(path, flipYAxis));
+	return it != textures.end() ? it->second : nullptr;
+}
+
+void AssetCache::addTexture(const std::filesystem::path& path, bool flipYAxis, std::shared_ptr<Texture> texture) {
+	textures[textureKey(path, flipYAxis)] = std::move(texture);
+}
+
+void AssetCache::purgeUnused() {
+	for (auto it = models.begin(); it != models.end();) {
+		bool used = false;
+		for (auto const& mesh : it->second->meshes) {
+			if (mesh.getGeometry().use_count() > 1) {
+				used = true;
+				break;
+			}
+		}
+
+		if (used)
+			++it;
+		else
+			it = models.erase(it);
+	}
+
+	// textures last, erased prototypes above may have held the only other reference
+	for (auto it = textures.begin(); it != textures.end();) {
+		if (it->second.use_count() > 1)
+			++it;
+		else
+			it = textures.erase(it);
+	}
+}
+
+void AssetCache::clear() {
+	models.clear();
+	textures.clear();
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "Texture.h"
+
+class Model;
+class ShaderProgram;
+
+// Shares GPU geometry and textures between models. Cached models are prototypes:
+// every get returns a copy with its own origin, orientation and materials, while
+// vertex/index buffers and textures are reference counted and uploaded only once.
+class AssetCache {
+public:
+	AssetCache();
+	~AssetCache();
+
+	// OBJ file, keyed by path, shader and texture flip
+	Model getModel(const std::filesystem::path& path, ShaderProgram& shader, bool flipTextureYAxis = false);
+
+	// procedural geometry, key has to describe all parameters the factory depends on
+	Model getProcedural(const std::string& key, ShaderProgram& shader, const std::function<Model()>& factory);
+
+	std::shared_ptr<Texture> getTexture(const std::filesystem::path& path, bool flipYAxis);
+
+	// lookups and inserts for assets created elsewhere (AssetLoader), nullptr when not cached
+	const Model* findModel(const std::string& key, const ShaderProgram& shader) const;
+	Model addModel(const std::string& key, ShaderProgram& shader, Model&& model);
+	std::shared_ptr<Texture> findTexture(const std::filesystem::path& path, bool flipYAxis) const;
+	void addTexture(const std::filesystem::path& path, bool flipYAxis, std::shared_ptr<Texture> texture);
+
+	static std::string modelKey(const std::filesystem::path& path, bool flipTextureYAxis);
+	static std::string textureKey(const std::filesystem::path& path, bool flipYAxis);
+	// model key of one shader, the cache stores models under this
+	static std::string shaderKey(const std::string& key, const ShaderProgram& shader);
+
+	// drop assets that are no longer referenced by any model outside the cache
+	void purgeUnused();
+	void clear();
+
+	size_t modelCount() const { return models.size(); }
+	size_t textureCount() const { return textures.size(); }
+
+private:
+	std::unordered_map<std::string, std::unique_ptr<Model>> models;
+	std::unordered_map<std::string, std::shared_ptr<Texture>> textures;
+};
+
+extern AssetCache gAssetCache;
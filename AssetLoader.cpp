@@ -0,0 +1,305 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include "AssetLoader.h"
+#include "AssetCache.h"
+#include "Assets.h"
+#include "MeshCache.h"
+#include "Model.h"
+
+AssetLoader::AssetLoader(ThreadPool& pool) : pool(pool) {}
+
+AssetLoader::~AssetLoader() = default;
+
+void AssetLoader::init() {
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glCreateBuffers(1, &stagingBuffer);
+	glNamedBufferStorage(stagingBuffer, STAGING_SIZE * STAGING_REGIONS, nullptr, flags);
+	stagingMapped = static_cast<unsigned char*>(glMapNamedBufferRange(stagingBuffer, 0, STAGING_SIZE * STAGING_REGIONS, flags));
+
+	// not fatal, everything is uploaded directly from CPU memory then
+	if (!stagingMapped)
+		std::cerr << "Asset staging buffer can not be mapped, uploading directly.\n";
+}
+
+void AssetLoader::destroy() {
+	// workers still hold the jobs, let them finish before the GL objects go away
+	for (auto& job : jobs) {
+		if (job->ready.valid())
+			job->ready.wait();
+	}
+	jobs.clear();
+	jobsByKey.clear();
+
+	for (auto& fence : stagingFences) {
+		if (fence) {
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+
+	if (stagingBuffer != 0) {
+		glUnmapNamedBuffer(stagingBuffer);
+		glDeleteBuffers(1, &stagingBuffer);
+		stagingBuffer = 0;
+		stagingMapped = nullptr;
+	}
+}
+
+Model* AssetLoader::loadModel(const std::filesystem::path& path, ShaderProgram& shader, bool flipTextureYAxis) {
+	std::string key = AssetCache::modelKey(path, flipTextureYAxis);
+
+	if (const Model* cached = gAssetCache.findModel(key, shader))
+		return new Model(*cached);
+
+	Model* model = new Model(Assets::createCube(1.0f, glm::vec4(0.5f, 0.5f, 0.5f, 1.0f), shader));
+
+	// the same file requested twice for the same shader is loaded once
+	std::string jobKey = AssetCache::shaderKey(key, shader);
+	auto found = jobsByKey.find(jobKey);
+	if (found != jobsByKey.end()) {
+		found->second->targets.push_back(model);
+		return model;
+	}
+
+	auto job = std::make_shared<Job>();
+	job->key = key;
+	job->jobKey = jobKey;
+	job->path = path;
+	job->shader = &shader;
+	job->flipTextureYAxis = flipTextureYAxis;
+	job->targets.push_back(model);
+	job->ready = pool.enqueue([job]() { prepare(*job); });
+
+	jobs.push_back(job);
+	jobsByKey.emplace(jobKey, job);
+	return model;
+}
+
+// worker thread, no OpenGL calls
+void AssetLoader::prepare(Job& job) {
+	std::vector<MeshData> data;
+	if (!MeshCache::read(job.path, data)) {
+		data = Model::loadObj(job.path);
+		MeshCache::write(job.path, data);
+	}
+
+	std::filesystem::path baseDir = job.path.parent_path();
+	job.meshes.reserve(data.size());
+
+	for (auto& meshData : data) {
+		if (meshData.vertices.empty() || meshData.indices.empty())
+			continue;
+
+		if (!meshData.texturePath.empty() && job.images.count(meshData.texturePath) == 0) {
+			ImageData image;
+			if (decodeImage((baseDir / meshData.texturePath).string(), job.flipTextureYAxis, image))
+				job.images.emplace(meshData.texturePath, std::move(image));
+		}
+
+		PreparedMesh mesh;
+		mesh.data = std::move(meshData);
+		if (mesh.data.vertices.size() <= 0x10000) {
+			mesh.shortIndices.assign(mesh.data.indices.begin(), mesh.data.indices.end());
+			mesh.data.indices = std::vector<GLuint>();
+		}
+		job.meshes.push_back(std::move(mesh));
+	}
+}
+
+void AssetLoader::update(double budgetMilliseconds) {
+	if (jobs.empty())
+		return;
+
+	auto start = std::chrono::steady_clock::now();
+	auto overBudget = [&]() {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() >= budgetMilliseconds;
+	};
+
+	beginStaging();
+
+	bool stop = false;
+	for (auto it = jobs.begin(); it != jobs.end() && !stop;) {
+		Job& job = **it;
+
+		if (!job.prepared) {
+			if (job.ready.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+				++it;
+				continue;
+			}
+
+			try {
+				job.ready.get();
+				job.prepared = true;
+			}
+			catch (const std::exception& e) {
+				// targets keep the placeholder
+				std::cerr << "Failed to load model " << job.path.string() << ": " << e.what() << '\n';
+				jobsByKey.erase(job.jobKey);
+				it = jobs.erase(it);
+				continue;
+			}
+		}
+
+		// at least one step per frame, so a tiny budget still makes progress
+		while (job.textures.size() < job.images.size() || job.uploadedMeshes < job.meshes.size()) {
+			if (!uploadNext(job) || overBudget()) {
+				stop = true;
+				break;
+			}
+		}
+
+		if (job.textures.size() == job.images.size() && job.uploadedMeshes == job.meshes.size()) {
+			finish(job);
+			jobsByKey.erase(job.jobKey);
+			it = jobs.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+
+	endStaging();
+}
+
+bool AssetLoader::uploadNext(Job& job) {
+	if (job.textures.size() < job.images.size())
+		return uploadTexture(job);
+	return uploadMesh(job);
+}
+
+bool AssetLoader::uploadTexture(Job& job) {
+	for (auto& [name, image] : job.images) {
+		if (job.textures.count(name))
+			continue;
+
+		std::filesystem::path path = job.path.parent_path() / name;
+
+		// another model may have uploaded it already
+		std::shared_ptr<Texture> texture = gAssetCache.findTexture(path, job.flipTextureYAxis);
+		if (!texture) {
+			GLsizeiptr size = static_cast<GLsizeiptr>(image.size());
+			GLintptr offset = stage(image.pixels.get(), size);
+
+			GLuint id;
+			if (offset >= 0) {
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+				id = createTexture(image.width, image.height, image.channels, reinterpret_cast<const void*>(offset));
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			}
+			else if (!stagingMapped || size > STAGING_SIZE) {
+				id = createTexture(image.width, image.height, image.channels, image.pixels.get());
+			}
+			else {
+				return false; // staging region full, next frame
+			}
+
+			texture = std::make_shared<Texture>(id);
+			gAssetCache.addTexture(path, job.flipTextureYAxis, texture);
+		}
+
+		image.pixels.reset();
+		job.textures.emplace(name, std::move(texture));
+		return true;
+	}
+	return true;
+}
+
+bool AssetLoader::uploadMesh(Job& job) {
+	PreparedMesh& prepared = job.meshes[job.uploadedMeshes];
+	MeshData& data = prepared.data;
+
+	bool shortIndices = !prepared.shortIndices.empty();
+	GLenum indexType = shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	const void* indices = shortIndices ? static_cast<const void*>(prepared.shortIndices.data()) : data.indices.data();
+	size_t indexCount = shortIndices ? prepared.shortIndices.size() : data.indices.size();
+
+	GLsizeiptr vertexBytes = static_cast<GLsizeiptr>(data.vertices.size() * sizeof(Vertex));
+	GLsizeiptr indexBytes = static_cast<GLsizeiptr>(indexCount * (shortIndices ? sizeof(GLushort) : sizeof(GLuint)));
+
+	std::shared_ptr<MeshGeometry> geometry;
+
+	GLintptr vertexOffset = stage(data.vertices.data(), vertexBytes);
+	GLintptr indexOffset = vertexOffset >= 0 ? stage(indices, indexBytes) : -1;
+	if (vertexOffset >= 0 && indexOffset >= 0) {
+		GLuint buffers[2];
+		glCreateBuffers(2, buffers);
+		glNamedBufferStorage(buffers[0], vertexBytes, nullptr, 0);
+		glNamedBufferStorage(buffers[1], indexBytes, nullptr, 0);
+		glCopyNamedBufferSubData(stagingBuffer, buffers[0], vertexOffset, 0, vertexBytes);
+		glCopyNamedBufferSubData(stagingBuffer, buffers[1], indexOffset, 0, indexBytes);
+
+		AABB bounds = AABB::fromVertices(data.vertices.data(), data.vertices.size());
+		geometry = std::make_shared<MeshGeometry>(buffers[0], buffers[1], data.vertices.size(), indexCount, indexType, bounds);
+	}
+	else if (!stagingMapped || vertexBytes + indexBytes > STAGING_SIZE) {
+		geometry = std::make_shared<MeshGeometry>(data.vertices.data(), data.vertices.size(), indices, indexCount, indexType);
+	}
+	else {
+		return false; // staging region full, next frame
+	}
+
+	std::shared_ptr<Texture> texture;
+	auto found = job.textures.find(data.texturePath);
+	if (found != job.textures.end())
+		texture = found->second;
+
+	Mesh mesh(GL_TRIANGLES, *job.shader, geometry, glm::vec3(0.0f), glm::vec3(0.0f), texture);
+	mesh.ambient_material = data.ambient;
+	mesh.diffuse_material = data.diffuse;
+	mesh.specular_material = data.specular;
+	mesh.shininess = data.shininess;
+	job.uploaded.push_back(std::move(mesh));
+
+	// CPU copy is not needed anymore
+	data.vertices = std::vector<Vertex>();
+	data.indices = std::vector<GLuint>();
+	prepared.shortIndices = std::vector<GLushort>();
+
+	job.uploadedMeshes++;
+	return true;
+}
+
+void AssetLoader::finish(Job& job) {
+	Model model = gAssetCache.addModel(job.key, *job.shader, Model(std::move(job.uploaded)));
+
+	// swap the placeholder meshes, origin and orientation of the targets stay
+	for (Model* target : job.targets) {
+		target->meshes.clear();
+		for (auto const& mesh : model.meshes)
+			target->meshes.push_back(mesh);
+	}
+
+	std::cout << "Loaded " << job.path.filename().string() << '\n';
+}
+
+void AssetLoader::beginStaging() {
+	stagingRegion = (stagingRegion + 1) % STAGING_REGIONS;
+	stagingUsed = 0;
+
+	// copies from this region two frames ago have to be done before it is overwritten
+	GLsync& fence = stagingFences[stagingRegion];
+	if (fence) {
+		glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+}
+
+void AssetLoader::endStaging() {
+	if (stagingUsed > 0)
+		stagingFences[stagingRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+GLintptr AssetLoader::stage(const void* data, GLsizeiptr size) {
+	GLsizeiptr aligned = (stagingUsed + 15) & ~GLsizeiptr(15);
+	if (!stagingMapped || aligned + size > STAGING_SIZE)
+		return -1;
+
+	GLintptr offset = stagingRegion * STAGING_SIZE + aligned;
+	std::memcpy(stagingMapped + offset, data, size);
+	stagingUsed = aligned + size;
+	return offset;
+}
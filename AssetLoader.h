@@ -0,0 +1,91 @@
+#pragma once
+
+#include <filesystem>
+#include <future>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "Mesh.h"
+#include "MeshData.h"
+#include "Texture.h"
+#include "ThreadPool.h"
+
+class Model;
+class ShaderProgram;
+
+// Loads OBJ models in the background: files are parsed (or read from the mesh cache) and
+// textures decoded on ThreadPool workers, GL objects are created on the render thread in
+// update(), which spends at most a given time per frame. Until then models show a placeholder.
+class AssetLoader {
+public:
+	explicit AssetLoader(ThreadPool& pool);
+	~AssetLoader();
+
+	void init();
+	void destroy();
+
+	// returns a model owned by the caller, it shows a placeholder cube until the file is uploaded.
+	// the model has to outlive the loader or be loaded already (see pending())
+	Model* loadModel(const std::filesystem::path& path, ShaderProgram& shader, bool flipTextureYAxis = false);
+
+	// render thread, once per frame
+	void update(double budgetMilliseconds);
+
+	size_t pending() const { return jobs.size(); }
+
+private:
+	static constexpr GLsizeiptr STAGING_SIZE = 16 * 1024 * 1024;
+	static constexpr int STAGING_REGIONS = 2;
+
+	struct PreparedMesh {
+		MeshData data;
+		std::vector<GLushort> shortIndices; // filled when the vertex count fits 16-bit indices
+	};
+
+	struct Job {
+		std::string key;
+		std::string jobKey;		// key and shader, a file loaded for two shaders is two jobs
+		std::filesystem::path path;
+		ShaderProgram* shader;
+		bool flipTextureYAxis;
+		std::vector<Model*> targets;
+
+		// written by the worker, read after the future is ready
+		std::future<void> ready;
+		std::vector<PreparedMesh> meshes;
+		std::map<std::string, ImageData> images;
+
+		// upload progress on the render thread
+		bool prepared = false;
+		size_t uploadedMeshes = 0;
+		std::map<std::string, std::shared_ptr<Texture>> textures;
+		std::vector<Mesh> uploaded;
+	};
+
+	ThreadPool& pool;
+	std::vector<std::shared_ptr<Job>> jobs;
+	std::unordered_map<std::string, std::shared_ptr<Job>> jobsByKey;
+
+	// persistent mapped staging buffer, one region written per frame
+	GLuint stagingBuffer = 0;
+	unsigned char* stagingMapped = nullptr;
+	GLsync stagingFences[STAGING_REGIONS]{};
+	int stagingRegion = 0;
+	GLsizeiptr stagingUsed = 0;
+
+	static void prepare(Job& job);
+	bool uploadNext(Job& job);
+	bool uploadTexture(Job& job);
+	bool uploadMesh(Job& job);
+	void finish(Job& job);
+
+	void beginStaging();
+	void endStaging();
+	// offset into the staging buffer, -1 when the current region has no space left
+	GLintptr stage(const void* data, GLsizeiptr size);
+};
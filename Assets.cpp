@@ -21,6 +21,12 @@ float Assets::fractalPerlin(glm::vec2 pos, int octaves, float lacunarity, float
 }
 
 Model Assets::createGrid(int gridSize, ShaderProgram& shader) {
+	return gAssetCache.getProcedural("grid:" + std::to_string(gridSize), shader, [&]() {
+		return buildGrid(gridSize, shader);
+	});
+}
+
+Model Assets::buildGrid(int gridSize, ShaderProgram& shader) {
 	std::vector<Vertex> gridVertices;
 	std::vector<GLuint> gridIndices;
 
@@ -56,6 +62,19 @@ Model Assets::createGrid(int gridSize, ShaderProgram& shader) {
 }
 
 Model Assets::createCube(float size, const glm::vec4& color, ShaderProgram& shader) {
+	// geometry is shared between all cubes of the same size, color is per copy
+	Model m = gAssetCache.getProcedural("cube:" + std::to_string(size), shader, [&]() {
+		return buildCube(size, shader);
+	});
+
+	m.meshes[0].ambient_material = color;
+	m.meshes[0].diffuse_material = color;
+	m.meshes[0].specular_material = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
+
+	return m;
+}
+
+Model Assets::buildCube(float size, ShaderProgram& shader) {
 	float halfSize = size / 2.0f;
 	std::vector<Vertex> vertices = {
 		// Front face (normal (0,0,1))
@@ -99,13 +118,7 @@ Model Assets::createCube(float size, const glm::vec4& color, ShaderProgram& shad
 		20, 23, 22, 22, 21, 20
 	};
 
-	Model m = Model(GL_TRIANGLES, vertices, indices, shader);
-
-	m.meshes[0].ambient_material = color;
-	m.meshes[0].diffuse_material = color;
-	m.meshes[0].specular_material = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
-
-	return m;
+	return Model(GL_TRIANGLES, vertices, indices, shader);
 }
 
 Model Assets::createTerrain(int gridSize, float heightScale, float frequency, ShaderProgram& shader) {
@@ -115,9 +128,7 @@ Model Assets::createTerrain(int gridSize, float heightScale, float frequency, Sh
 	const float lacunarity = PERLIN_LACUNARITY;
 	const float persistence = PERLIN_PERSISTENCE;
 
-	terrainGridSize = gridSize;
-	terrainHeightScale = heightScale;
-	terrainFrequency = frequency;
+	setTerrainParameters(gridSize, heightScale, frequency);
 
 	int numVerticesPerSide = terrainGridSize + 1;
 	std::vector<Vertex> vertices(numVerticesPerSide * numVerticesPerSide);
@@ -178,6 +189,12 @@ Model Assets::createTerrain(int gridSize, float heightScale, float frequency, Sh
 	return Model(GL_TRIANGLES, vertices, indices, shader);
 }
 
+void Assets::setTerrainParameters(int gridSize, float heightScale, float frequency) {
+	terrainGridSize = gridSize;
+	terrainHeightScale = heightScale;
+	terrainFrequency = frequency;
+}
+
 float Assets::getTerrainHeightAtPosition(float x, float z) {
 	const int octaves = PERLIN_OCTAVES;
 	const float lacunarity = PERLIN_LACUNARITY;
@@ -189,6 +206,19 @@ float Assets::getTerrainHeightAtPosition(float x, float z) {
 }
 
 Model Assets::createSphere(float radius, int sectorCount, int stackCount, const glm::vec4& color, ShaderProgram& shader) {
+	std::string key = "sphere:" + std::to_string(radius) + ':' + std::to_string(sectorCount) + ':' + std::to_string(stackCount);
+	Model m = gAssetCache.getProcedural(key, shader, [&]() {
+		return buildSphere(radius, sectorCount, stackCount, shader);
+	});
+
+	m.meshes[0].ambient_material = color;
+	m.meshes[0].diffuse_material = color;
+	m.meshes[0].specular_material = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
+
+	return m;
+}
+
+Model Assets::buildSphere(float radius, int sectorCount, int stackCount, ShaderProgram& shader) {
 	std::vector<Vertex> vertices;
 	std::vector<GLuint> indices;
 
@@ -230,10 +260,5 @@ Model Assets::createSphere(float radius, int sectorCount, int stackCount, const
 		}
 	}
 
-	Model m = Model(GL_TRIANGLES, vertices, indices, shader);
-	m.meshes[0].ambient_material = color;
-	m.meshes[0].diffuse_material = color;
-	m.meshes[0].specular_material = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
-
-	return m;
+	return Model(GL_TRIANGLES, vertices, indices, shader);
 }
@@ -8,6 +8,7 @@
 #include "Model.h"
 #include "ShaderProgram.h"
 #include "Light.h"
+#include "AssetCache.h"
 
 #define PERLIN_OCTAVES 6
 #define PERLIN_LACUNARITY 2.0f
@@ -18,6 +19,11 @@ private:
 
 	static float fractalPerlin(glm::vec2 pos, int octaves, float lacunarity, float persistence);
 
+	// uncached geometry builders, create* functions go through gAssetCache
+	static Model buildGrid(int gridSize, ShaderProgram& shader);
+	static Model buildCube(float size, ShaderProgram& shader);
+	static Model buildSphere(float radius, int sectorCount, int stackCount, ShaderProgram& shader);
+
 	static int terrainGridSize;
 	static float terrainHeightScale;
 	static float terrainFrequency;
@@ -27,6 +33,7 @@ public:
 	static Model createGrid(int gridSize, ShaderProgram& shader);
 	static Model createCube(float size, const glm::vec4& color, ShaderProgram& shader);
 	static Model createTerrain(int gridSize, float heightScale, float frequency, ShaderProgram& shader);
+	static void setTerrainParameters(int gridSize, float heightScale, float frequency);
 	static float getTerrainHeightAtPosition(float worldX, float worldZ);
 	static Model createSphere(float radius, int sectorCount, int stackCount, const glm::vec4& color, ShaderProgram& shader);
 
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+
+#include "RingBuffer.h"
+
+// what push() does when the queue is full
+enum class OverflowPolicy {
+	Block,		// wait until the consumer makes room
+	DropOldest,	// discard the oldest queued item
+	KeepLatest	// discard everything queued, only the newest item is kept
+};
+
+// Bounded variant of ThreadSafeQueue on top of a lock-free ring buffer. Memory use is constant
+// and pushes and pops do not lock; the mutex is only touched when a thread has to sleep.
+// Ring = SPSCRingBuffer<T> for one producer and one consumer, it supports OverflowPolicy::Block only
+// (dropping needs the producer to pop).
+template <typename T, typename Ring = MPMCRingBuffer<T>>
+class BoundedQueue {
+public:
+	explicit BoundedQueue(size_t capacity, OverflowPolicy policy = OverflowPolicy::Block) : ring(capacity), policy(policy) {
+		if (!Ring::MULTI_CONSUMER && policy != OverflowPolicy::Block)
+			throw std::invalid_argument("BoundedQueue: dropping items needs a multi-consumer ring buffer");
+	}
+
+	BoundedQueue(const BoundedQueue&) = delete;
+	BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+	// false when the queue was stopped (Block only, the other policies always succeed)
+	bool push(T&& item) {
+		switch (policy) {
+		case OverflowPolicy::Block:
+			while (!try_push(std::move(item))) {
+				std::unique_lock<std::mutex> lock(mutex_);
+				waitingProducers.fetch_add(1);
+				notFull.wait(lock, [this] { return stopped.load() || count.load() < ring.capacity(); });
+				waitingProducers.fetch_sub(1);
+				if (stopped.load())
+					return false;
+			}
+			return true;
+
+		case OverflowPolicy::KeepLatest:
+			discard(SIZE_MAX);
+			[[fallthrough]];
+
+		case OverflowPolicy::DropOldest:
+			// other producers may refill the freed slot, so retry
+			while (!try_push(std::move(item)))
+				discard(1);
+			return true;
+		}
+		return false;
+	}
+
+	bool push(const T& item) {
+		T copy(item);
+		return push(std::move(copy));
+	}
+
+	// never waits or drops, false when full
+	bool try_push(T&& item) {
+		if (!ring.try_push(std::move(item)))
+			return false;
+
+		count.fetch_add(1);
+		if (waitingConsumers.load() > 0) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			notEmpty.notify_one();
+		}
+		return true;
+	}
+
+	bool try_pop(T& item) {
+		if (!ring.try_pop(item))
+			return false;
+
+		count.fetch_sub(1);
+		if (waitingProducers.load() > 0) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			notFull.notify_one();
+		}
+		return true;
+	}
+
+	// waits for an item, false once the queue is stopped and empty
+	bool pop(T& item) {
+		while (!try_pop(item)) {
+			std::unique_lock<std::mutex> lock(mutex_);
+			waitingConsumers.fetch_add(1);
+			notEmpty.wait(lock, [this] { return stopped.load() || count.load() > 0; });
+			waitingConsumers.fetch_sub(1);
+			if (stopped.load() && count.load() == 0)
+				return false;
+		}
+		return true;
+	}
+
+	// false on timeout or when stopped and empty
+	template <typename Rep, typename Period>
+	bool pop(T& item, const std::chrono::duration<Rep, Period>& timeout) {
+		auto deadline = std::chrono::steady_clock::now() + timeout;
+		while (!try_pop(item)) {
+			std::unique_lock<std::mutex> lock(mutex_);
+			waitingConsumers.fetch_add(1);
+			bool ready = notEmpty.wait_until(lock, deadline, [this] { return stopped.load() || count.load() > 0; });
+			waitingConsumers.fetch_sub(1);
+			if (!ready || (stopped.load() && count.load() == 0))
+				return false;
+		}
+		return true;
+	}
+
+	// wakes every waiting thread, queued items can still be popped
+	void stop() {
+		stopped.store(true);
+		std::lock_guard<std::mutex> lock(mutex_);
+		notEmpty.notify_all();
+		notFull.notify_all();
+	}
+
+	// consumer side for SPSC rings
+	void clear() {
+		T item;
+		while (try_pop(item)) {}
+	}
+
+	bool empty() const { return count.load() == 0; }
+	size_t size() const { return count.load(); }
+	size_t capacity() const { return ring.capacity(); }
+
+	// items discarded by DropOldest/KeepLatest
+	size_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+
+private:
+	Ring ring;
+	OverflowPolicy policy;
+
+	std::atomic<size_t> count{ 0 };
+	std::atomic<size_t> droppedCount{ 0 };
+	std::atomic<bool> stopped{ false };
+
+	// sleeping threads only
+	std::mutex mutex_;
+	std::condition_variable notEmpty;
+	std::condition_variable notFull;
+	std::atomic<int> waitingConsumers{ 0 };
+	std::atomic<int> waitingProducers{ 0 };
+
+	void discard(size_t maxItems) {
+		T old;
+		for (size_t i = 0; i < maxItems && ring.try_pop(old); i++) {
+			count.fetch_sub(1);
+			droppedCount.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cfloat>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include "Vertex.h"
+
+// axis aligned bounding box, empty until the first point is added
+struct AABB {
+	glm::vec3 min{ FLT_MAX };
+	glm::vec3 max{ -FLT_MAX };
+
+	bool valid() const { return min.x <= max.x; }
+
+	glm::vec3 center() const { return (min + max) * 0.5f; }
+	glm::vec3 extents() const { return (max - min) * 0.5f; }
+
+	void expand(const glm::vec3& point) {
+		min = glm::min(min, point);
+		max = glm::max(max, point);
+	}
+
+	void expand(const AABB& other) {
+		if (!other.valid())
+			return;
+		min = glm::min(min, other.min);
+		max = glm::max(max, other.max);
+	}
+
+	// box around the transformed box (Arvo), cheaper than transforming all 8 corners
+	AABB transformed(const glm::mat4& transform) const {
+		if (!valid())
+			return *this;
+
+		glm::vec3 c = glm::vec3(transform * glm::vec4(center(), 1.0f));
+		glm::mat3 m(transform);
+		glm::mat3 absM(glm::abs(m[0]), glm::abs(m[1]), glm::abs(m[2]));
+		glm::vec3 e = absM * extents();
+
+		AABB result;
+		result.min = c - e;
+		result.max = c + e;
+		return result;
+	}
+
+	static AABB fromVertices(const Vertex* vertices, size_t count) {
+		AABB box;
+		for (size_t i = 0; i < count; i++)
+			box.expand(vertices[i].position);
+		return box;
+	}
+};
+
+struct BoundingSphere {
+	glm::vec3 center{ 0.0f };
+	float radius{ -1.0f }; // negative = empty
+
+	bool valid() const { return radius >= 0.0f; }
+
+	static BoundingSphere fromAABB(const AABB& box) {
+		if (!box.valid())
+			return BoundingSphere{};
+		return BoundingSphere{ box.center(), glm::length(box.extents()) };
+	}
+};
+
+// view frustum planes extracted from projection * view (Gribb/Hartmann), normals point inside
+struct Frustum {
+	glm::vec4 planes[6];
+
+	static Frustum fromMatrix(const glm::mat4& m) {
+		glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+		glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+		glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+		glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+		Frustum frustum;
+		frustum.planes[0] = row3 + row0; // left
+		frustum.planes[1] = row3 - row0; // right
+		frustum.planes[2] = row3 + row1; // bottom
+		frustum.planes[3] = row3 - row1; // top
+		frustum.planes[4] = row3 + row2; // near
+		frustum.planes[5] = row3 - row2; // far
+
+		for (auto& plane : frustum.planes)
+			plane /= glm::length(glm::vec3(plane));
+
+		return frustum;
+	}
+
+	// conservative: boxes near frustum corners may pass, empty boxes are never culled
+	bool intersects(const AABB& box) const {
+		if (!box.valid())
+			return true;
+
+		glm::vec3 c = box.center();
+		glm::vec3 e = box.extents();
+		for (auto const& plane : planes) {
+			glm::vec3 n(plane);
+			if (glm::dot(n, c) + glm::dot(glm::abs(n), e) + plane.w < 0.0f)
+				return false;
+		}
+		return true;
+	}
+
+	bool intersects(const BoundingSphere& sphere) const {
+		if (!sphere.valid())
+			return true;
+
+		for (auto const& plane : planes) {
+			if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius)
+				return false;
+		}
+		return true;
+	}
+};
@@ -1,24 +1,32 @@
 #include "BoxCollider.h"
-#include "SphereCollider.h"
-
-bool BoxCollider::intersects(const Collider& other) const {
-    const BoxCollider* box = dynamic_cast<const BoxCollider*>(&other);
-    if (box) {
-        return (std::abs(center.x - box->center.x) <= (halfExtents.x + box->halfExtents.x)) &&
-            (std::abs(center.y - box->center.y) <= (halfExtents.y + box->halfExtents.y)) &&
-            (std::abs(center.z - box->center.z) <= (halfExtents.z + box->halfExtents.z));
-    }
-
-    const SphereCollider* sphere = dynamic_cast<const SphereCollider*>(&other);
-    if (sphere) {
-        glm::vec3 closestPoint = glm::clamp(sphere->center, center - halfExtents, center + halfExtents);
-        float distSq = glm::length2(sphere->center - closestPoint);
-        return distSq < (sphere->radius * sphere->radius);
-    }
-    return false;
-}
+#include "CollisionManager.h"
 
 void BoxCollider::update(const glm::vec3& position, const glm::vec3& scale) {
 	center = position;
 	halfExtents = scale / 2.0f;
+	gCollisionManager.updateCollider(this);
+}
+
+AABB BoxCollider::getBounds() const {
+	AABB box;
+	box.min = center - halfExtents;
+	box.max = center + halfExtents;
+	return box;
+}
+
+bool BoxCollider::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const {
+	// slab test, division by zero gives +-inf which compares correctly
+	glm::vec3 invDirection = 1.0f / direction;
+	glm::vec3 t1 = (center - halfExtents - origin) * invDirection;
+	glm::vec3 t2 = (center + halfExtents - origin) * invDirection;
+	glm::vec3 tMin = glm::min(t1, t2);
+	glm::vec3 tMax = glm::max(t1, t2);
+
+	float enter = std::fmax(std::fmax(tMin.x, tMin.y), std::fmax(tMin.z, 0.0f));
+	float exit = std::fmin(std::fmin(tMax.x, tMax.y), std::fmin(tMax.z, maxDistance));
+	if (enter > exit)
+		return false;
+
+	distance = enter;
+	return true;
 }
\ No newline at end of file
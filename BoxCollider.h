@@ -14,9 +14,11 @@ public:
     glm::vec3 halfExtents;
 
     BoxCollider(const glm::vec3& center, const glm::vec3& halfExtents)
-        : center(center), halfExtents(halfExtents) {}
-
-    virtual bool intersects(const Collider& other) const override;
+        : Collider(ColliderShape::Box), center(center), halfExtents(halfExtents) {}
 
     virtual void update(const glm::vec3& position, const glm::vec3& scale) override;
+
+    virtual AABB getBounds() const override;
+
+    virtual bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const override;
 };
\ No newline at end of file
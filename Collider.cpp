@@ -0,0 +1,49 @@
+#include "Collider.h"
+#include "BoxCollider.h"
+#include "SphereCollider.h"
+
+namespace {
+
+// the same formulas are used by the batch tests in CollisionManager, keep them in sync
+
+bool sphereSphere(const Collider& a, const Collider& b) {
+	const SphereCollider& s1 = static_cast<const SphereCollider&>(a);
+	const SphereCollider& s2 = static_cast<const SphereCollider&>(b);
+	float radii = s1.radius + s2.radius;
+	return glm::length2(s1.center - s2.center) < radii * radii;
+}
+
+bool sphereBox(const SphereCollider& sphere, const BoxCollider& box) {
+	glm::vec3 closestPoint = glm::clamp(sphere.center, box.center - box.halfExtents, box.center + box.halfExtents);
+	return glm::length2(sphere.center - closestPoint) < sphere.radius * sphere.radius;
+}
+
+bool sphereBox(const Collider& a, const Collider& b) {
+	return sphereBox(static_cast<const SphereCollider&>(a), static_cast<const BoxCollider&>(b));
+}
+
+bool boxSphere(const Collider& a, const Collider& b) {
+	return sphereBox(static_cast<const SphereCollider&>(b), static_cast<const BoxCollider&>(a));
+}
+
+bool boxBox(const Collider& a, const Collider& b) {
+	const BoxCollider& b1 = static_cast<const BoxCollider&>(a);
+	const BoxCollider& b2 = static_cast<const BoxCollider&>(b);
+	return (std::abs(b1.center.x - b2.center.x) <= (b1.halfExtents.x + b2.halfExtents.x)) &&
+		(std::abs(b1.center.y - b2.center.y) <= (b1.halfExtents.y + b2.halfExtents.y)) &&
+		(std::abs(b1.center.z - b2.center.z) <= (b1.halfExtents.z + b2.halfExtents.z));
+}
+
+using IntersectFunction = bool(*)(const Collider&, const Collider&);
+
+// [this shape][other shape]
+constexpr IntersectFunction intersectTable[size_t(ColliderShape::Count)][size_t(ColliderShape::Count)] = {
+	/* Sphere */ { sphereSphere, sphereBox },
+	/* Box    */ { boxSphere, boxBox },
+};
+
+}
+
+bool Collider::intersects(const Collider& other) const {
+	return intersectTable[size_t(shape)][size_t(other.shape)](*this, other);
+}
@@ -2,11 +2,36 @@
 
 #include <glm/glm.hpp>
 
+#include "Bounds.h"
+
+enum class ColliderShape {
+    Sphere,
+    Box,
+    Count
+};
+
 class Collider {
 public:
+    const ColliderShape shape;
+
+    // broadphase proxy and index into the per-shape pool, managed by CollisionManager (-1 = not registered)
+    int proxy = -1;
+    int poolIndex = -1;
+    bool moved = false; // refit pending, see CollisionManager::beginDeferredUpdates
+
     virtual ~Collider() {}
 
-    virtual bool intersects(const Collider& other) const = 0;
+    // narrowphase, dispatched through a shape x shape function table (no RTTI)
+    bool intersects(const Collider& other) const;
 
+    // moves the shape and refits it in the broadphase
     virtual void update(const glm::vec3& position, const glm::vec3& scale) = 0;
-};
\ No newline at end of file
+
+    virtual AABB getBounds() const = 0;
+
+    // distance along the normalized direction to the first hit, false when there is none within maxDistance
+    virtual bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const = 0;
+
+protected:
+    explicit Collider(ColliderShape shape) : shape(shape) {}
+};
@@ -1,3 +1,348 @@
 #include "CollisionManager.h"
+#include "BoxCollider.h"
+#include "SphereCollider.h"
 
-CollisionManager gCollisionManager;
\ No newline at end of file
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COLLISION_SSE2
+#include <emmintrin.h>
+#endif
+
+CollisionManager gCollisionManager;
+
+namespace {
+
+// pool slot of a collider, written on add and on every update
+void storeSphere(SpherePool& pool, size_t i, const SphereCollider& sphere) {
+	pool.x[i] = sphere.center.x;
+	pool.y[i] = sphere.center.y;
+	pool.z[i] = sphere.center.z;
+	pool.radius[i] = sphere.radius;
+}
+
+void storeBox(BoxPool& pool, size_t i, const BoxCollider& box) {
+	pool.x[i] = box.center.x;
+	pool.y[i] = box.center.y;
+	pool.z[i] = box.center.z;
+	pool.hx[i] = box.halfExtents.x;
+	pool.hy[i] = box.halfExtents.y;
+	pool.hz[i] = box.halfExtents.z;
+}
+
+template<class Pool, class... Arrays>
+void swapRemove(Pool& pool, size_t i, Arrays Pool::*... arrays) {
+	size_t last = pool.owner.size() - 1;
+	(((pool.*arrays)[i] = (pool.*arrays)[last]), ...);
+	((pool.*arrays).pop_back(), ...);
+
+	pool.owner[i] = pool.owner[last];
+	pool.owner.pop_back();
+	if (i < pool.owner.size())
+		pool.owner[i]->poolIndex = static_cast<int>(i);
+}
+
+// collects the owners of the set bits of a 4-lane compare mask
+inline void collectMask(int mask, size_t base, const std::vector<Collider*>& owner, const Collider* self, std::vector<Collider*>& hits) {
+	for (int lane = 0; lane < 4; lane++) {
+		if ((mask & (1 << lane)) && owner[base + lane] != self)
+			hits.push_back(owner[base + lane]);
+	}
+}
+
+// the formulas match the narrowphase functions in Collider.cpp, the scalar tails are the same code
+
+void sphereVsSpheres(const SphereCollider& s, const SpherePool& pool, std::vector<Collider*>& hits) {
+	size_t n = pool.owner.size();
+	size_t i = 0;
+#ifdef COLLISION_SSE2
+	__m128 cx = _mm_set1_ps(s.center.x), cy = _mm_set1_ps(s.center.y), cz = _mm_set1_ps(s.center.z);
+	__m128 r = _mm_set1_ps(s.radius);
+	for (; i + 4 <= n; i += 4) {
+		__m128 dx = _mm_sub_ps(cx, _mm_loadu_ps(&pool.x[i]));
+		__m128 dy = _mm_sub_ps(cy, _mm_loadu_ps(&pool.y[i]));
+		__m128 dz = _mm_sub_ps(cz, _mm_loadu_ps(&pool.z[i]));
+		__m128 dist2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		__m128 radii = _mm_add_ps(r, _mm_loadu_ps(&pool.radius[i]));
+		int mask = _mm_movemask_ps(_mm_cmplt_ps(dist2, _mm_mul_ps(radii, radii)));
+		if (mask)
+			collectMask(mask, i, pool.owner, &s, hits);
+	}
+#endif
+	for (; i < n; i++) {
+		float dx = s.center.x - pool.x[i], dy = s.center.y - pool.y[i], dz = s.center.z - pool.z[i];
+		float radii = s.radius + pool.radius[i];
+		if (dx * dx + dy * dy + dz * dz < radii * radii && pool.owner[i] != &s)
+			hits.push_back(pool.owner[i]);
+	}
+}
+
+void sphereVsBoxes(const SphereCollider& s, const BoxPool& pool, std::vector<Collider*>& hits) {
+	size_t n = pool.owner.size();
+	size_t i = 0;
+#ifdef COLLISION_SSE2
+	__m128 cx = _mm_set1_ps(s.center.x), cy = _mm_set1_ps(s.center.y), cz = _mm_set1_ps(s.center.z);
+	__m128 r2 = _mm_set1_ps(s.radius * s.radius);
+	for (; i + 4 <= n; i += 4) {
+		__m128 bx = _mm_loadu_ps(&pool.x[i]), by = _mm_loadu_ps(&pool.y[i]), bz = _mm_loadu_ps(&pool.z[i]);
+		__m128 hx = _mm_loadu_ps(&pool.hx[i]), hy = _mm_loadu_ps(&pool.hy[i]), hz = _mm_loadu_ps(&pool.hz[i]);
+		// distance to the closest point of the box
+		__m128 dx = _mm_sub_ps(cx, _mm_min_ps(_mm_max_ps(cx, _mm_sub_ps(bx, hx)), _mm_add_ps(bx, hx)));
+		__m128 dy = _mm_sub_ps(cy, _mm_min_ps(_mm_max_ps(cy, _mm_sub_ps(by, hy)), _mm_add_ps(by, hy)));
+		__m128 dz = _mm_sub_ps(cz, _mm_min_ps(_mm_max_ps(cz, _mm_sub_ps(bz, hz)), _mm_add_ps(bz, hz)));
+		__m128 dist2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		int mask = _mm_movemask_ps(_mm_cmplt_ps(dist2, r2));
+		if (mask)
+			collectMask(mask, i, pool.owner, &s, hits);
+	}
+#endif
+	for (; i < n; i++) {
+		float dx = s.center.x - std::min(std::max(s.center.x, pool.x[i] - pool.hx[i]), pool.x[i] + pool.hx[i]);
+		float dy = s.center.y - std::min(std::max(s.center.y, pool.y[i] - pool.hy[i]), pool.y[i] + pool.hy[i]);
+		float dz = s.center.z - std::min(std::max(s.center.z, pool.z[i] - pool.hz[i]), pool.z[i] + pool.hz[i]);
+		if (dx * dx + dy * dy + dz * dz < s.radius * s.radius && pool.owner[i] != &s)
+			hits.push_back(pool.owner[i]);
+	}
+}
+
+void boxVsSpheres(const BoxCollider& b, const SpherePool& pool, std::vector<Collider*>& hits) {
+	glm::vec3 minBound = b.center - b.halfExtents;
+	glm::vec3 maxBound = b.center + b.halfExtents;
+
+	size_t n = pool.owner.size();
+	size_t i = 0;
+#ifdef COLLISION_SSE2
+	__m128 minX = _mm_set1_ps(minBound.x), minY = _mm_set1_ps(minBound.y), minZ = _mm_set1_ps(minBound.z);
+	__m128 maxX = _mm_set1_ps(maxBound.x), maxY = _mm_set1_ps(maxBound.y), maxZ = _mm_set1_ps(maxBound.z);
+	for (; i + 4 <= n; i += 4) {
+		__m128 sx = _mm_loadu_ps(&pool.x[i]), sy = _mm_loadu_ps(&pool.y[i]), sz = _mm_loadu_ps(&pool.z[i]);
+		__m128 r = _mm_loadu_ps(&pool.radius[i]);
+		__m128 dx = _mm_sub_ps(sx, _mm_min_ps(_mm_max_ps(sx, minX), maxX));
+		__m128 dy = _mm_sub_ps(sy, _mm_min_ps(_mm_max_ps(sy, minY), maxY));
+		__m128 dz = _mm_sub_ps(sz, _mm_min_ps(_mm_max_ps(sz, minZ), maxZ));
+		__m128 dist2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		int mask = _mm_movemask_ps(_mm_cmplt_ps(dist2, _mm_mul_ps(r, r)));
+		if (mask)
+			collectMask(mask, i, pool.owner, &b, hits);
+	}
+#endif
+	for (; i < n; i++) {
+		float dx = pool.x[i] - std::min(std::max(pool.x[i], minBound.x), maxBound.x);
+		float dy = pool.y[i] - std::min(std::max(pool.y[i], minBound.y), maxBound.y);
+		float dz = pool.z[i] - std::min(std::max(pool.z[i], minBound.z), maxBound.z);
+		if (dx * dx + dy * dy + dz * dz < pool.radius[i] * pool.radius[i] && pool.owner[i] != &b)
+			hits.push_back(pool.owner[i]);
+	}
+}
+
+void boxVsBoxes(const BoxCollider& b, const BoxPool& pool, std::vector<Collider*>& hits) {
+	size_t n = pool.owner.size();
+	size_t i = 0;
+#ifdef COLLISION_SSE2
+	__m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	__m128 cx = _mm_set1_ps(b.center.x), cy = _mm_set1_ps(b.center.y), cz = _mm_set1_ps(b.center.z);
+	__m128 hx = _mm_set1_ps(b.halfExtents.x), hy = _mm_set1_ps(b.halfExtents.y), hz = _mm_set1_ps(b.halfExtents.z);
+	for (; i + 4 <= n; i += 4) {
+		__m128 inX = _mm_cmple_ps(_mm_and_ps(_mm_sub_ps(cx, _mm_loadu_ps(&pool.x[i])), absMask), _mm_add_ps(hx, _mm_loadu_ps(&pool.hx[i])));
+		__m128 inY = _mm_cmple_ps(_mm_and_ps(_mm_sub_ps(cy, _mm_loadu_ps(&pool.y[i])), absMask), _mm_add_ps(hy, _mm_loadu_ps(&pool.hy[i])));
+		__m128 inZ = _mm_cmple_ps(_mm_and_ps(_mm_sub_ps(cz, _mm_loadu_ps(&pool.z[i])), absMask), _mm_add_ps(hz, _mm_loadu_ps(&pool.hz[i])));
+		int mask = _mm_movemask_ps(_mm_and_ps(_mm_and_ps(inX, inY), inZ));
+		if (mask)
+			collectMask(mask, i, pool.owner, &b, hits);
+	}
+#endif
+	for (; i < n; i++) {
+		if (std::abs(b.center.x - pool.x[i]) <= b.halfExtents.x + pool.hx[i]
+			&& std::abs(b.center.y - pool.y[i]) <= b.halfExtents.y + pool.hy[i]
+			&& std::abs(b.center.z - pool.z[i]) <= b.halfExtents.z + pool.hz[i]
+			&& pool.owner[i] != &b)
+			hits.push_back(pool.owner[i]);
+	}
+}
+
+}
+
+void CollisionManager::addCollider(Collider* col) {
+	if (!col || col->proxy != -1)
+		return;
+
+	col->proxy = tree.createProxy(col->getBounds(), col);
+	colliders.push_back(col);
+
+	switch (col->shape) {
+	case ColliderShape::Sphere:
+		col->poolIndex = static_cast<int>(spheres.owner.size());
+		spheres.owner.push_back(col);
+		for (auto* v : { &spheres.x, &spheres.y, &spheres.z, &spheres.radius })
+			v->emplace_back();
+		storeSphere(spheres, col->poolIndex, static_cast<const SphereCollider&>(*col));
+		break;
+	case ColliderShape::Box:
+		col->poolIndex = static_cast<int>(boxes.owner.size());
+		boxes.owner.push_back(col);
+		for (auto* v : { &boxes.x, &boxes.y, &boxes.z, &boxes.hx, &boxes.hy, &boxes.hz })
+			v->emplace_back();
+		storeBox(boxes, col->poolIndex, static_cast<const BoxCollider&>(*col));
+		break;
+	default:
+		break;
+	}
+}
+
+void CollisionManager::removeCollider(Collider* col) {
+	if (!col || col->proxy == -1)
+		return;
+
+	tree.destroyProxy(col->proxy);
+	col->proxy = -1;
+
+	switch (col->shape) {
+	case ColliderShape::Sphere:
+		swapRemove(spheres, col->poolIndex, &SpherePool::x, &SpherePool::y, &SpherePool::z, &SpherePool::radius);
+		break;
+	case ColliderShape::Box:
+		swapRemove(boxes, col->poolIndex, &BoxPool::x, &BoxPool::y, &BoxPool::z, &BoxPool::hx, &BoxPool::hy, &BoxPool::hz);
+		break;
+	default:
+		break;
+	}
+	col->poolIndex = -1;
+	colliders.erase(std::remove(colliders.begin(), colliders.end(), col), colliders.end());
+}
+
+void CollisionManager::updateCollider(Collider* col) {
+	if (col->proxy == -1)
+		return;
+
+	if (deferUpdates) {
+		col->moved = true;
+		return;
+	}
+
+	tree.moveProxy(col->proxy, col->getBounds());
+
+	switch (col->shape) {
+	case ColliderShape::Sphere:
+		storeSphere(spheres, col->poolIndex, static_cast<const SphereCollider&>(*col));
+		break;
+	case ColliderShape::Box:
+		storeBox(boxes, col->poolIndex, static_cast<const BoxCollider&>(*col));
+		break;
+	default:
+		break;
+	}
+}
+
+void CollisionManager::commitUpdates() {
+	deferUpdates = false;
+
+	for (Collider* col : colliders) {
+		if (col->moved) {
+			col->moved = false;
+			updateCollider(col);
+		}
+	}
+}
+
+void CollisionManager::batchCollide(const Collider& col, std::vector<Collider*>& hits) const {
+	switch (col.shape) {
+	case ColliderShape::Sphere: {
+		const SphereCollider& sphere = static_cast<const SphereCollider&>(col);
+		sphereVsSpheres(sphere, spheres, hits);
+		sphereVsBoxes(sphere, boxes, hits);
+		break;
+	}
+	case ColliderShape::Box: {
+		const BoxCollider& box = static_cast<const BoxCollider&>(col);
+		boxVsSpheres(box, spheres, hits);
+		boxVsBoxes(box, boxes, hits);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+std::vector<Collider*> CollisionManager::checkCollisions(const Collider* col) const {
+	std::vector<Collider*> hits;
+	if (colliders.size() <= LINEAR_SCAN_LIMIT) {
+		batchCollide(*col, hits);
+		return hits;
+	}
+
+	tree.query(col->getBounds(), [&](int proxy) {
+		Collider* other = static_cast<Collider*>(tree.getUserData(proxy));
+		if (other != col && col->intersects(*other))
+			hits.push_back(other);
+		return true;
+	});
+	return hits;
+}
+
+void CollisionManager::queryAABB(const AABB& box, std::vector<Collider*>& results) const {
+	results.clear();
+
+	// the narrowphase works on colliders, so the query box is one too
+	BoxCollider probe(box.center(), box.extents());
+	tree.query(box, [&](int proxy) {
+		Collider* other = static_cast<Collider*>(tree.getUserData(proxy));
+		if (probe.intersects(*other))
+			results.push_back(other);
+		return true;
+	});
+}
+
+void CollisionManager::querySphere(const glm::vec3& center, float radius, std::vector<Collider*>& results) const {
+	results.clear();
+
+	SphereCollider probe(center, radius);
+	tree.query(probe.getBounds(), [&](int proxy) {
+		Collider* other = static_cast<Collider*>(tree.getUserData(proxy));
+		if (probe.intersects(*other))
+			results.push_back(other);
+		return true;
+	});
+}
+
+bool CollisionManager::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RaycastHit& hit) const {
+	float length = glm::length(direction);
+	if (length <= 0.0f)
+		return false;
+	glm::vec3 dir = direction / length;
+
+	hit.collider = nullptr;
+	tree.raycast(origin, dir, maxDistance, [&](int proxy, float currentMax) {
+		Collider* other = static_cast<Collider*>(tree.getUserData(proxy));
+		float distance;
+		if (!other->raycast(origin, dir, currentMax, distance))
+			return currentMax;
+
+		hit.collider = other;
+		hit.distance = distance;
+		// a hit at the origin can not be beaten, anything else only clips the ray
+		return distance;
+	});
+
+	if (!hit.collider)
+		return false;
+
+	hit.point = origin + dir * hit.distance;
+	return true;
+}
+
+const std::vector<std::pair<Collider*, Collider*>>& CollisionManager::computeOverlappingPairs() {
+	pairs.clear();
+
+	for (Collider* col : colliders) {
+		tree.query(col->getBounds(), [&](int proxy) {
+			// each pair is reported by the collider with the lower proxy id only
+			if (proxy <= col->proxy)
+				return true;
+
+			Collider* other = static_cast<Collider*>(tree.getUserData(proxy));
+			if (col->intersects(*other))
+				pairs.emplace_back(col, other);
+			return true;
+		});
+	}
+
+	return pairs;
+}
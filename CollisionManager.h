@@ -1,29 +1,76 @@
 #pragma once
 
+#include <algorithm>
+#include <utility>
 #include <vector>
+
+#include <glm/glm.hpp>
+
+#include "AABBTree.h"
+#include "Bounds.h"
 #include "Collider.h"
 
+struct RaycastHit {
+    Collider* collider = nullptr;
+    float distance = 0.0f;
+    glm::vec3 point{ 0.0f };
+};
+
+// structure of arrays copy of all colliders of one shape, for SIMD batch tests
+struct SpherePool {
+    std::vector<float> x, y, z, radius;
+    std::vector<Collider*> owner;
+};
+
+struct BoxPool {
+    std::vector<float> x, y, z, hx, hy, hz;
+    std::vector<Collider*> owner;
+};
+
+// Colliders live in a dynamic AABB tree (broadphase), candidates are then tested exactly (narrowphase).
+// Colliders refit themselves in update(), so queries are O(log n) instead of a scan over all colliders.
+// Small scenes skip the tree and test the per-shape pools 4 colliders at a time.
 class CollisionManager {
 public:
     std::vector<Collider*> colliders;
 
-    void addCollider(Collider* col) {
-        colliders.push_back(col);
-    }
-
-    void removeCollider(Collider* col) {
-        colliders.erase(std::remove(colliders.begin(), colliders.end(), col), colliders.end());
-    }
-    
-    std::vector<Collider*> checkCollisions(const Collider* col) {
-        std::vector<Collider*> hits;
-        for (auto other : colliders) {
-            if (other != col && col->intersects(*other)) {
-                hits.push_back(other);
-            }
-        }
-        return hits;
-    }
+    void addCollider(Collider* col);
+    void removeCollider(Collider* col);
+
+    // refit after the collider moved, cheap while it stays inside its fat box
+    void updateCollider(Collider* col);
+
+    // while deferred, colliders may be updated from several threads and are only flagged,
+    // commitUpdates() then refits them serially in collider order (deterministic tree)
+    void beginDeferredUpdates() { deferUpdates = true; }
+    void commitUpdates();
+
+    std::vector<Collider*> checkCollisions(const Collider* col) const;
+
+    // results are cleared first
+    void queryAABB(const AABB& box, std::vector<Collider*>& results) const;
+    void querySphere(const glm::vec3& center, float radius, std::vector<Collider*>& results) const;
+
+    // closest hit along the ray, direction does not need to be normalized
+    bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RaycastHit& hit) const;
+
+    // every intersecting pair once, valid until the next call
+    const std::vector<std::pair<Collider*, Collider*>>& computeOverlappingPairs();
+
+    // every collider of the pools against one shape, no broadphase
+    void batchCollide(const Collider& col, std::vector<Collider*>& hits) const;
+
+    size_t getTreeHeight() const { return tree.getHeight(); }
+
+private:
+    // below this count a SIMD scan of the pools is cheaper than walking the tree
+    static constexpr size_t LINEAR_SCAN_LIMIT = 128;
+
+    AABBTree tree;
+    bool deferUpdates = false;
+    SpherePool spheres;
+    BoxPool boxes;
+    std::vector<std::pair<Collider*, Collider*>> pairs;
 };
 
-extern CollisionManager gCollisionManager;
\ No newline at end of file
+extern CollisionManager gCollisionManager;
@@ -4,6 +4,7 @@
 
 #include "Model.h"
 #include "Collider.h"
+#include "CollisionManager.h"
 
 class Entity {
 public:
@@ -22,8 +23,10 @@ public:
         : model(model), collider(col), position(startPos), orientation(0.0f), scale(scale) {}
 
     virtual ~Entity() {
-		if (collider)
+		if (collider) {
+			gCollisionManager.removeCollider(collider);
 			delete collider;
+		}
 		if (model)
             delete model;
     }
@@ -42,11 +45,7 @@ public:
 
         // sync collider with position
         if (collider) {
-            if (SphereCollider* sphere = dynamic_cast<SphereCollider*>(collider)) {
-				collider->update(position, glm::vec3(scale));
-            } else if (BoxCollider* box = dynamic_cast<BoxCollider*>(collider)) {
-				collider->update(position, glm::vec3(scale));
-            }
+            collider->update(position, scale);
         }
     }
 
@@ -80,6 +79,30 @@ public:
         orientation.y = targetYaw;
     }
 
+    // world space bounds, same transform as submit()/draw()
+    virtual AABB getWorldBounds() const {
+        if (!model)
+            return AABB{};
+        return model->getBounds().transformed(Mesh::makeTransform(position, orientation));
+    }
+
+    BoundingSphere getWorldSphere() const {
+        if (!model)
+            return BoundingSphere{};
+        BoundingSphere sphere = BoundingSphere::fromAABB(model->getBounds());
+        if (sphere.valid())
+            sphere.center = glm::vec3(Mesh::makeTransform(position, orientation) * glm::vec4(sphere.center, 1.0f));
+        return sphere;
+    }
+
+    virtual void submit(InstanceBatch& batch) {
+        if (model) {
+            model->origin = position;
+            model->orientation = orientation;
+            model->submit(batch);
+        }
+    }
+
 	void setAlpha(float alpha) {
 		if (model) {
 			model->setAlpha(alpha);
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include <opencv2\opencv.hpp>
+
+#include "RingBuffer.h"
+
+// Shared handle to a pooled frame. Stages pass it along instead of cv::Mat copies, and the
+// buffer returns to the pool when the last handle is released.
+// Treat it as read-only after it was queued, and keep the handle, not a cv::Mat header, while
+// reading: the buffer is written in place by its next owner.
+using FrameRef = std::shared_ptr<cv::Mat>;
+
+using StreamClock = std::chrono::steady_clock;
+
+// frame plus what the streaming stages need for latency accounting
+struct TimedFrame {
+	FrameRef frame;
+	uint64_t id = 0;
+	StreamClock::time_point captured{};
+	StreamClock::time_point decoded{};	// only set for frames that went through the codec
+};
+
+// Recycling pool of at most maxFrames image buffers. A recycled cv::Mat keeps its allocation, so
+// VideoCapture::read, copyTo and friends reuse it as long as size and type stay the same.
+class FramePool {
+public:
+	explicit FramePool(size_t maxFrames) : state(std::make_shared<State>(maxFrames)) {}
+
+	FramePool(const FramePool&) = delete;
+	FramePool& operator=(const FramePool&) = delete;
+
+	// empty handle when every buffer is in flight, the caller drops the frame
+	FrameRef acquire() {
+		cv::Mat* mat = nullptr;
+		if (!state->freeFrames.try_pop(mat)) {
+			size_t count = state->allocated.load(std::memory_order_relaxed);
+			do {
+				if (count >= state->maxFrames)
+					return nullptr;
+			} while (!state->allocated.compare_exchange_weak(count, count + 1, std::memory_order_relaxed));
+
+			mat = new cv::Mat();
+		}
+
+		// the deleter keeps the state alive, frames may outlive the pool
+		std::shared_ptr<State> owner = state;
+		return FrameRef(mat, [owner](cv::Mat* m) { owner->recycle(m); });
+	}
+
+	// buffers created so far, never more than maxFrames
+	size_t allocated() const { return state->allocated.load(std::memory_order_relaxed); }
+	size_t capacity() const { return state->maxFrames; }
+
+private:
+	struct State {
+		explicit State(size_t maxFrames) : freeFrames(maxFrames), maxFrames(maxFrames) {}
+
+		~State() {
+			cv::Mat* mat = nullptr;
+			while (freeFrames.try_pop(mat))
+				delete mat;
+		}
+
+		void recycle(cv::Mat* mat) {
+			// someone still holds a header to the pixels, do not let the next owner overwrite them
+			if (mat->u && mat->u->refcount > 1)
+				mat->release();
+
+			if (!freeFrames.try_push(std::move(mat)))
+				delete mat;
+		}
+
+		MPMCRingBuffer<cv::Mat*> freeFrames;
+		const size_t maxFrames;
+		std::atomic<size_t> allocated{ 0 };
+	};
+
+	std::shared_ptr<State> state;
+};
@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+
+#include "GpuParticles.h"
+#include "ObjectBuffer.h"
+
+namespace {
+    // buffer bindings used by particleCS.glsl, ObjectBuffer::BINDING is 2
+    constexpr GLuint PARTICLES_IN_BINDING = 3;
+    constexpr GLuint PARTICLES_OUT_BINDING = 4;
+    constexpr GLuint SPAWNS_BINDING = 5;
+    constexpr GLuint COMMANDS_BINDING = 6;
+    constexpr GLuint OBJECTS_BINDING = 7;
+}
+
+bool GpuParticles::init(const Mesh& particleMesh) {
+    destroy();
+
+    if (!GLEW_ARB_compute_shader && !GLEW_VERSION_4_3) {
+        std::cerr << "GPU particles: compute shaders not supported\n";
+        return false;
+    }
+
+    try {
+        compute = ShaderProgram("particleCS.glsl");
+    }
+    catch (const std::exception& e) {
+        std::cerr << "GPU particles: " << e.what() << '\n';
+        return false;
+    }
+
+    deltaTimeUniform = compute.getUniformHandle("deltaTime");
+    spawnCountUniform = compute.getUniformHandle("spawnCount");
+    capacityUniform = compute.getUniformHandle("capacity");
+    sourceUniform = compute.getUniformHandle("source");
+    specularUniform = compute.getUniformHandle("specular");
+    shininessUniform = compute.getUniformHandle("shininess");
+
+    mesh = &particleMesh;
+
+    glCreateBuffers(2, particles);
+    for (GLuint buffer : particles)
+        glNamedBufferStorage(buffer, CAPACITY * sizeof(Particle), nullptr, 0);
+
+    glCreateBuffers(1, &spawnBuffer);
+    glNamedBufferStorage(spawnBuffer, SPAWN_CAPACITY * sizeof(Particle), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+    glCreateBuffers(1, &objectBuffer);
+    glNamedBufferStorage(objectBuffer, CAPACITY * sizeof(ObjectBlock), nullptr, 0);
+
+    // instanceCount is the only field the shader touches
+    GLuint indexCount = static_cast<GLuint>(mesh->getGeometry()->indexCount);
+    DrawCommand commands[2] = { { indexCount, 0, 0, 0, 0 }, { indexCount, 0, 0, 0, 0 } };
+    glCreateBuffers(1, &commandBuffer);
+    glNamedBufferStorage(commandBuffer, sizeof(commands), commands, GL_DYNAMIC_STORAGE_BIT);
+
+    source = 0;
+    return true;
+}
+
+void GpuParticles::spawn(const glm::vec3& position, const glm::vec3& velocity, float lifetime, const glm::vec3& color) {
+    // a burst bigger than the pool would be dropped by the shader anyway
+    if (pending.size() >= CAPACITY)
+        return;
+    pending.push_back(Particle{ glm::vec4(position, lifetime), glm::vec4(velocity, lifetime), glm::vec4(color, 1.0f) });
+}
+
+void GpuParticles::update(float deltaTime) {
+    if (!ready())
+        return;
+
+    GLsizei spawnCount = static_cast<GLsizei>(std::min<size_t>(pending.size(), SPAWN_CAPACITY));
+    if (spawnCount > 0) {
+        glNamedBufferSubData(spawnBuffer, 0, spawnCount * sizeof(Particle), pending.data());
+        pending.erase(pending.begin(), pending.begin() + spawnCount);
+    }
+
+    // the target pool starts empty, the shader appends survivors and new particles to it
+    int target = 1 - source;
+    GLuint zero = 0;
+    glClearNamedBufferSubData(commandBuffer, GL_R32UI, target * sizeof(DrawCommand) + offsetof(DrawCommand, instanceCount),
+        sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PARTICLES_IN_BINDING, particles[source]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PARTICLES_OUT_BINDING, particles[target]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SPAWNS_BINDING, spawnBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMANDS_BINDING, commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECTS_BINDING, objectBuffer);
+
+    MaterialBlock material = mesh->getMaterialBlock();
+    compute.activate();
+    compute.setUniform(deltaTimeUniform, deltaTime);
+    compute.setUniform(spawnCountUniform, static_cast<int>(spawnCount));
+    compute.setUniform(capacityUniform, static_cast<int>(CAPACITY));
+    compute.setUniform(sourceUniform, source);
+    compute.setUniform(specularUniform, material.specular);
+    compute.setUniform(shininessUniform, material.shininess);
+
+    // the live count is only known on the GPU, so the whole pool is covered and idle invocations exit early
+    glDispatchCompute(CAPACITY / GROUP_SIZE, 1, 1);
+    // the draw reads the counts, the next update clears them with glClearNamedBufferSubData
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    source = target;
+}
+
+void GpuParticles::draw() const {
+    if (!ready())
+        return;
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ObjectBuffer::BINDING, objectBuffer);
+    mesh->drawIndirect(commandBuffer, source * sizeof(DrawCommand));
+    gObjectBuffer.bind();
+}
+
+void GpuParticles::clear() {
+    pending.clear();
+    if (!ready())
+        return;
+
+    GLuint zero = 0;
+    for (int i = 0; i < 2; i++)
+        glClearNamedBufferSubData(commandBuffer, GL_R32UI, i * sizeof(DrawCommand) + offsetof(DrawCommand, instanceCount),
+            sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+}
+
+void GpuParticles::destroy() {
+    pending.clear();
+    if (!ready())
+        return;
+
+    glDeleteBuffers(2, particles);
+    glDeleteBuffers(1, &spawnBuffer);
+    glDeleteBuffers(1, &commandBuffer);
+    glDeleteBuffers(1, &objectBuffer);
+    particles[0] = particles[1] = spawnBuffer = commandBuffer = objectBuffer = 0;
+
+    compute.clear();
+    mesh = nullptr;
+}
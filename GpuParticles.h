@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+#include "ShaderProgram.h"
+
+// Particle pool that lives in shader storage buffers. particleCS.glsl ages, moves and compacts the
+// particles into the other half of a ping-pong pair, writes their ObjectBlocks and the instance count
+// of an indirect draw, so nothing is ever read back to the CPU.
+class GpuParticles {
+public:
+    static constexpr GLuint CAPACITY = 262144;
+    static constexpr GLuint SPAWN_CAPACITY = 16384;   // per update, the rest waits for the next one
+    static constexpr GLuint GROUP_SIZE = 256;         // local_size_x in particleCS.glsl
+
+    GpuParticles() = default;
+    GpuParticles(const GpuParticles&) = delete;
+    GpuParticles& operator=(const GpuParticles&) = delete;
+    ~GpuParticles() { destroy(); }
+
+    // compiles particleCS.glsl and creates the buffers, false when compute is not usable
+    bool init(const Mesh& mesh);
+    bool ready() const { return particles[0] != 0; }
+
+    // queued until the next update
+    void spawn(const glm::vec3& position, const glm::vec3& velocity, float lifetime, const glm::vec3& color);
+
+    void update(float deltaTime);
+
+    // one indirect draw, leaves gObjectBuffer bound again
+    void draw() const;
+
+    // kills every particle and drops queued spawns
+    void clear();
+
+    void destroy();
+
+private:
+    // std430 layout of Particle in particleCS.glsl
+    struct Particle {
+        glm::vec4 positionLife;
+        glm::vec4 velocitySpan;
+        glm::vec4 color;
+    };
+
+    // DrawElementsIndirectCommand
+    struct DrawCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    ShaderProgram compute;
+    UniformHandle deltaTimeUniform, spawnCountUniform, capacityUniform, sourceUniform, specularUniform, shininessUniform;
+
+    const Mesh* mesh = nullptr;
+    GLuint particles[2] = { 0, 0 };
+    GLuint spawnBuffer = 0;
+    GLuint commandBuffer = 0;   // DrawCommand[2], commands[source] counts particles[source]
+    GLuint objectBuffer = 0;
+    int source = 0;
+
+    std::vector<Particle> pending;
+};
@@ -0,0 +1,58 @@
+#include <algorithm>
+
+#include "Heightfield.h"
+
+Heightfield::Heightfield(int cells, float spacing, const std::function<float(float x, float z)>& generator, ThreadPool* pool)
+    : cellCount(std::max(cells, 1)), stride(cellCount + 1), step(spacing), half(cellCount * spacing * 0.5f), heights(static_cast<size_t>(stride) * stride) {
+    auto rows = [&](size_t begin, size_t end) {
+        for (size_t z = begin; z < end; ++z) {
+            float* row = heights.data() + z * stride;
+            for (int x = 0; x < stride; ++x)
+                row[x] = generator(x * step - half, z * step - half);
+        }
+    };
+
+    if (pool)
+        pool->parallel_for(0, stride, 16, rows);
+    else
+        rows(0, stride);
+
+    auto range = std::minmax_element(heights.begin(), heights.end());
+    minY = *range.first;
+    maxY = *range.second;
+}
+
+const float* Heightfield::locate(float x, float z, float& fx, float& fz) const {
+    float gx = std::clamp((x + half) / step, 0.0f, static_cast<float>(cellCount));
+    float gz = std::clamp((z + half) / step, 0.0f, static_cast<float>(cellCount));
+    int ix = std::min(static_cast<int>(gx), cellCount - 1);
+    int iz = std::min(static_cast<int>(gz), cellCount - 1);
+    fx = gx - ix;
+    fz = gz - iz;
+    return heights.data() + iz * stride + ix;
+}
+
+float Heightfield::sample(float x, float z) const {
+    float fx, fz;
+    const float* cell = locate(x, z, fx, fz);
+    float h00 = cell[0], h10 = cell[1], h01 = cell[stride], h11 = cell[stride + 1];
+
+    if (fx + fz <= 1.0f)
+        return h00 + fx * (h10 - h00) + fz * (h01 - h00);
+    return h11 + (1.0f - fx) * (h01 - h11) + (1.0f - fz) * (h10 - h11);
+}
+
+void Heightfield::sampleHeights(const glm::vec2* points, size_t count, float* out) const {
+    for (size_t i = 0; i < count; ++i)
+        out[i] = sample(points[i].x, points[i].y);
+}
+
+glm::vec3 Heightfield::normal(float x, float z) const {
+    float fx, fz;
+    const float* cell = locate(x, z, fx, fz);
+    float h00 = cell[0], h10 = cell[1], h01 = cell[stride], h11 = cell[stride + 1];
+
+    if (fx + fz <= 1.0f)
+        return glm::normalize(glm::vec3(h00 - h10, step, h00 - h01));
+    return glm::normalize(glm::vec3(h01 - h11, step, h10 - h11));
+}
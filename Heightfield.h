@@ -0,0 +1,40 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "ThreadPool.h"
+
+// Square grid of heights, generated once and sampled with the same triangle split as the terrain
+// chunks (diagonal from (x, z + 1) to (x + 1, z)), so queries match the finest rendered level.
+class Heightfield {
+public:
+    // (cells + 1)^2 samples spacing apart, centred on the origin, rows generated in parallel on pool
+    Heightfield(int cells, float spacing, const std::function<float(float x, float z)>& generator, ThreadPool* pool = nullptr);
+
+    // positions outside the grid are clamped to its border
+    float sample(float x, float z) const;
+    void sampleHeights(const glm::vec2* points, size_t count, float* heights) const;
+
+    // normal of the triangle under (x, z)
+    glm::vec3 normal(float x, float z) const;
+
+    int cells() const { return cellCount; }
+    float spacing() const { return step; }
+    float minHeight() const { return minY; }
+    float maxHeight() const { return maxY; }
+
+private:
+    // cell containing (x, z) and the position inside it in [0, 1]
+    const float* locate(float x, float z, float& fx, float& fz) const;
+
+    int cellCount;
+    int stride;
+    float step;
+    float half;
+    float minY = 0.0f;
+    float maxY = 0.0f;
+    std::vector<float> heights;     // row-major, stride samples per row
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+#include "ObjectBuffer.h"
+
+// Gathers draws of the same geometry during a frame and submits every group
+// with a single instanced draw. Per-instance transform and material go to
+// gObjectBuffer as consecutive ObjectBlocks.
+class InstanceBatch {
+public:
+	void add(const Mesh& mesh, const glm::mat4& model) {
+		add(mesh, model, mesh.getMaterialBlock());
+	}
+
+	void add(const Mesh& mesh, const glm::mat4& model, const MaterialBlock& material) {
+		Key key{ mesh.getVAO(), mesh.getTextureID(), &mesh.shader };
+		auto it = groupIndex.find(key);
+		if (it == groupIndex.end()) {
+			it = groupIndex.emplace(key, activeGroups).first;
+			if (activeGroups == groups.size())
+				groups.emplace_back();
+			groups[activeGroups].mesh = &mesh;
+			activeGroups++;
+		}
+		groups[it->second].instances.push_back(ObjectBlock{ model, material });
+	}
+
+	// draw and clear all gathered groups, keeps allocated memory for the next frame
+	void flush() {
+		for (size_t i = 0; i < activeGroups; i++) {
+			Group& group = groups[i];
+			GLuint count = static_cast<GLuint>(group.instances.size());
+			GLuint first;
+			ObjectBlock* dst = gObjectBuffer.allocate(count, first);
+			if (dst) {
+				std::copy(group.instances.begin(), group.instances.end(), dst);
+				group.mesh->drawInstanced(first, static_cast<GLsizei>(count));
+				drawCalls++;
+				instanceCount += count;
+			}
+			group.instances.clear();
+			group.mesh = nullptr;
+		}
+
+		groupIndex.clear();
+		activeGroups = 0;
+	}
+
+	// statistics of every flush() since the last resetStats()
+	void resetStats() {
+		drawCalls = 0;
+		instanceCount = 0;
+	}
+	size_t getDrawCalls() const { return drawCalls; }
+	size_t getInstanceCount() const { return instanceCount; }
+
+private:
+	struct Key {
+		GLuint vao;
+		GLuint texture;
+		const ShaderProgram* shader;
+
+		bool operator==(const Key& other) const {
+			return vao == other.vao && texture == other.texture && shader == other.shader;
+		}
+	};
+
+	struct KeyHash {
+		size_t operator()(const Key& key) const {
+			size_t h = std::hash<GLuint>()(key.vao);
+			h ^= std::hash<GLuint>()(key.texture) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			h ^= std::hash<const void*>()(key.shader) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			return h;
+		}
+	};
+
+	struct Group {
+		const Mesh* mesh = nullptr;
+		std::vector<ObjectBlock> instances;
+	};
+
+	std::unordered_map<Key, size_t, KeyHash> groupIndex;
+	std::vector<Group> groups;
+	size_t activeGroups = 0;
+
+	size_t drawCalls = 0;
+	size_t instanceCount = 0;
+};
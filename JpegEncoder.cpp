@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+
+#include "JpegEncoder.h"
+
+namespace {
+	constexpr double MODEL_ALPHA = 0.3;
+}
+
+JpegEncoder::JpegEncoder(ThreadPool* pool) : pool(pool), params{ cv::IMWRITE_JPEG_QUALITY, 0 } {
+	std::fill(std::begin(bytesPerPixel), std::end(bytesPerPixel), 0.0);
+	qualityProbes.resize(pool ? std::min<size_t>(pool->size() + 1, 4) : 1);
+}
+
+size_t JpegEncoder::encode(const cv::Mat& img, int quality, std::vector<uchar>& bytes) {
+	static const bool haveWriter = cv::haveImageWriter(".jpg");
+	if (!haveWriter)
+		throw std::runtime_error("Can not compress to format: .jpg");
+
+	params[1] = quality;
+	cv::imencode(".jpg", img, bytes, params);
+	stats_.bandwidth.encodes++;
+	stats_.bandwidth.lastEncodes++;
+
+	double bpp = static_cast<double>(bytes.size()) / std::max<size_t>(img.total(), 1);
+	double& model = bytesPerPixel[quality];
+	model = model > 0.0 ? model + MODEL_ALPHA * (bpp - model) : bpp;
+
+	return bytes.size();
+}
+
+int JpegEncoder::predictQuality(double targetBytesPerPixel, int lo, int hi) const {
+	// highest quality in (lo, hi) the model expects to fit, unknown qualities take the closer known neighbour
+	int fallback = std::clamp(previousQuality, lo + 1, hi - 1);
+	int best = -1;
+	double nearestAbove = 0.0;
+	for (int q = 100; q >= 1; q--) {
+		if (bytesPerPixel[q] > 0.0)
+			nearestAbove = bytesPerPixel[q];
+		if (q >= hi || q <= lo)
+			continue;
+
+		double estimate = bytesPerPixel[q] > 0.0 ? bytesPerPixel[q] : nearestAbove;
+		if (estimate > 0.0 && estimate <= targetBytesPerPixel) {
+			best = q;
+			break;
+		}
+	}
+	return best > 0 ? best : fallback;
+}
+
+void JpegEncoder::encodeLimitBW(const cv::Mat& img, size_t sizeLimit, std::vector<uchar>& out) {
+	stats_.bandwidth.frames++;
+	stats_.bandwidth.lastEncodes = 0;
+
+	// lo fits (0 = nothing yet), hi does not (101 = nothing yet)
+	int lo = 0, hi = 101;
+	double target = static_cast<double>(sizeLimit) / std::max<size_t>(img.total(), 1);
+	int quality = predictQuality(target, lo, hi);
+	int modelProbes = 0;
+
+	for (;;) {
+		if (encode(img, quality, probe) <= sizeLimit) {
+			lo = quality;
+			std::swap(out, probe);
+		} else {
+			hi = quality;
+		}
+
+		if (hi - lo <= 1)
+			break;
+
+		// a good model brackets the answer in one or two more probes, plain bisection otherwise
+		if (++modelProbes <= 2)
+			quality = predictQuality(target, lo, hi);
+		else
+			quality = (lo + hi) / 2;
+	}
+
+	// nothing fitted, quality 1 was the last and smallest encode
+	if (lo == 0) {
+		std::swap(out, probe);
+		stats_.bandwidth.fallbacks++;
+	}
+
+	previousQuality = std::max(lo, 1);
+	stats_.bandwidth.lastQuality = previousQuality;
+	stats_.bandwidth.lastRatio = sizeLimit ? static_cast<double>(out.size()) / sizeLimit : 0.0;
+}
+
+void JpegEncoder::encodeLimitQuality(const cv::Mat& img, double targetPsnr, std::vector<uchar>& out) {
+	static const bool haveWriter = cv::haveImageWriter(".jpg");
+	if (!haveWriter)
+		throw std::runtime_error("Cannot compress to format: .jpg");
+
+	stats_.quality.frames++;
+	stats_.quality.lastEncodes = 0;
+
+	const cv::Mat* reference = &img;
+	if (approximatePsnr) {
+		cv::resize(img, sourceSmall, cv::Size(), 0.5, 0.5, cv::INTER_NEAREST);
+		reference = &sourceSmall;
+	}
+
+	// PSNR grows with quality: lo is known to miss the target (0 = none yet), hi to reach it (101 = none yet)
+	std::atomic<int> lo{ 0 }, hi{ 101 };
+	std::atomic<size_t> encodes{ 0 };
+	std::mutex bestMutex;
+	int bestQuality = 101;
+
+	auto evaluate = [&](QualityProbe& probe) {
+		int q = probe.quality;
+		auto inBracket = [&] { return q > lo.load() && q < hi.load(); };
+		if (!inBracket())
+			return;
+
+		probe.params[1] = q;
+		cv::imencode(".jpg", img, probe.bytes, probe.params);
+		encodes++;
+		if (!inBracket())
+			return;
+
+		cv::imdecode(probe.bytes, cv::IMREAD_COLOR, &probe.decoded);
+		const cv::Mat* decoded = &probe.decoded;
+		if (approximatePsnr) {
+			cv::resize(probe.decoded, probe.decodedSmall, cv::Size(), 0.5, 0.5, cv::INTER_NEAREST);
+			decoded = &probe.decodedSmall;
+		}
+
+		if (cv::PSNR(*reference, *decoded) >= targetPsnr) {
+			int current = hi.load();
+			while (q < current && !hi.compare_exchange_weak(current, q)) {}
+
+			std::lock_guard<std::mutex> lock(bestMutex);
+			if (q < bestQuality) {
+				bestQuality = q;
+				std::swap(out, probe.bytes);
+			}
+		} else {
+			int current = lo.load();
+			while (q > current && !lo.compare_exchange_weak(current, q)) {}
+		}
+	};
+
+	const size_t slots = qualityProbes.size();
+	std::vector<int> candidates;
+	int gallop = 1;
+	while (hi.load() - lo.load() > 1) {
+		int l = lo.load(), h = hi.load();
+
+		candidates.clear();
+		if (l == 0 && h == 101) {
+			// previous answer and its neighbour settle a steady stream in one round
+			int q = std::clamp(previousPsnrQuality, 2, 100);
+			candidates = { q, q - 1, q - 4, q + 3 };
+		} else if (h == 101) {
+			for (size_t i = 0; i < slots; i++, gallop *= 2)
+				candidates.push_back(std::min(l + gallop, 100));
+		} else if (l == 0) {
+			for (size_t i = 0; i < slots; i++, gallop *= 2)
+				candidates.push_back(std::max(h - gallop, 1));
+		} else {
+			for (size_t i = 0; i < slots; i++)
+				candidates.push_back(l + static_cast<int>((h - l) * (i + 1) / (slots + 1)));
+		}
+
+		// in (l, h), no duplicates, most useful first, at most one per slot
+		size_t count = 0;
+		for (int q : candidates) {
+			if (count < slots && q > l && q < h && std::find(candidates.begin(), candidates.begin() + count, q) == candidates.begin() + count)
+				candidates[count++] = q;
+		}
+		if (count == 0)
+			candidates[count++] = (l + h) / 2;
+		candidates.resize(count);
+
+		for (size_t i = 0; i < count; i++)
+			qualityProbes[i].quality = candidates[i];
+
+		if (pool && candidates.size() > 1) {
+			pool->parallel_for(0, candidates.size(), 1, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++)
+					evaluate(qualityProbes[i]);
+			});
+		} else {
+			for (size_t i = 0; i < candidates.size(); i++)
+				evaluate(qualityProbes[i]);
+		}
+	}
+
+	stats_.quality.encodes += encodes.load();
+	stats_.quality.lastEncodes = encodes.load();
+
+	if (hi.load() > 100) {
+		stats_.quality.fallbacks++;
+		throw std::runtime_error("Cannot achieve target PSNR with available quality settings.");
+	}
+
+	previousPsnrQuality = hi.load();
+	stats_.quality.lastQuality = previousPsnrQuality;
+	stats_.quality.lastRatio = static_cast<double>(out.size()) / std::max<size_t>(img.total() * img.elemSize(), 1);
+}
+
+std::string JpegEncoder::report() const {
+	static const char* names[] = { "bandwidth", "quality" };
+	const ModeStats* modes[] = { &stats_.bandwidth, &stats_.quality };
+
+	std::string out;
+	char line[160];
+	for (size_t i = 0; i < 2; i++) {
+		const ModeStats& s = *modes[i];
+		if (s.frames == 0)
+			continue;
+		if (out.empty())
+			out = "JPEG quality search (frames / encodes per frame / fallbacks / last quality / last ratio):\n";
+		std::snprintf(line, sizeof(line), "  %-10s %7zu %7.2f %7zu %7d %7.3f\n", names[i], s.frames, s.encodesPerFrame(), s.fallbacks, s.lastQuality, s.lastRatio);
+		out += line;
+	}
+	return out;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <opencv2\opencv.hpp>
+
+#include "ThreadPool.h"
+
+// JPEG encoder for the streaming pipeline. Keeps state between frames (last chosen quality,
+// size model, buffers), so use one instance per encoding thread.
+class JpegEncoder {
+public:
+	// kept per search, the two need very different numbers of encodes
+	struct ModeStats {
+		size_t frames = 0;
+		size_t encodes = 0;			// imencode calls in total
+		size_t fallbacks = 0;		// frames no quality was good enough for
+		int lastQuality = 0;
+		size_t lastEncodes = 0;		// imencode calls for the last frame
+		double lastRatio = 0.0;
+
+		double encodesPerFrame() const { return frames ? static_cast<double>(encodes) / frames : 0.0; }
+	};
+
+	struct Stats {
+		ModeStats bandwidth;		// encodeLimitBW, ratio = output size / size limit, fallback = quality 1
+		ModeStats quality;			// encodeLimitQuality, ratio = output size / raw size, fallback = throw
+	};
+
+	// pool == nullptr runs the quality search on the calling thread
+	explicit JpegEncoder(ThreadPool* pool = nullptr);
+
+	// compare every second row and column only in encodeLimitQuality
+	bool approximatePsnr = false;
+
+	// Highest JPEG quality whose output fits into sizeLimit bytes (quality 1 when none does).
+	// Bisects the quality range, starting from a guess of a running quality -> bytes model.
+	void encodeLimitBW(const cv::Mat& img, size_t sizeLimit, std::vector<uchar>& out);
+
+	// Lowest JPEG quality whose decoded image reaches targetPsnr, throws when even 100 does not.
+	// Several qualities are tried in parallel, starting next to the previous answer and galloping or
+	// splitting the bracket; probes that fall outside the bracket meanwhile are skipped.
+	void encodeLimitQuality(const cv::Mat& img, double targetPsnr, std::vector<uchar>& out);
+
+	const Stats& stats() const { return stats_; }
+	// one line per search that was used, empty when none was
+	std::string report() const;
+
+private:
+	// exponential moving average of bytes per pixel per quality, 0 = not seen yet
+	double bytesPerPixel[101];
+	int previousQuality = 75;
+	int previousPsnrQuality = 75;
+
+	ThreadPool* pool;
+	std::vector<int> params;
+	std::vector<uchar> probe;
+
+	// buffers of one parallel quality probe, reused between frames
+	struct QualityProbe {
+		std::vector<int> params{ cv::IMWRITE_JPEG_QUALITY, 0 };
+		std::vector<uchar> bytes;
+		cv::Mat decoded, decodedSmall;
+		int quality = 0;
+	};
+	std::vector<QualityProbe> qualityProbes;
+	cv::Mat sourceSmall;
+
+	Stats stats_;
+
+	size_t encode(const cv::Mat& img, int quality, std::vector<uchar>& bytes);
+	int predictQuality(double targetBytesPerPixel, int lo, int hi) const;
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "FramePool.h"
+
+// each stage is measured from the timestamp of the previous one, EndToEnd from capture to display
+enum class StreamStage {
+	Encode,
+	Transport,
+	Decode,
+	Display,
+	EndToEnd,
+	Count
+};
+
+// Sliding window of the latest samples per stage with percentiles computed on demand.
+// Recording is a short lock per sample, meant for per-frame rates.
+class LatencyStats {
+public:
+	struct Percentiles {
+		size_t samples = 0;
+		double p50 = 0.0, p95 = 0.0, p99 = 0.0, max = 0.0;	// milliseconds
+	};
+
+	explicit LatencyStats(size_t window = 1024) : window(window) {
+		for (auto& s : stages)
+			s.samples.reserve(window);
+	}
+
+	void record(StreamStage stage, StreamClock::duration latency) {
+		float ms = std::chrono::duration<float, std::milli>(latency).count();
+		Stage& s = stages[static_cast<size_t>(stage)];
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (s.samples.size() < window)
+			s.samples.push_back(ms);
+		else
+			s.samples[s.next] = ms;
+		s.next = (s.next + 1) % window;
+	}
+
+	// frames dropped for being too late
+	void recordDrop() {
+		std::lock_guard<std::mutex> lock(mutex);
+		drops++;
+	}
+
+	Percentiles percentiles(StreamStage stage) const {
+		std::vector<float> sorted;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			sorted = stages[static_cast<size_t>(stage)].samples;
+		}
+
+		Percentiles p;
+		p.samples = sorted.size();
+		if (sorted.empty())
+			return p;
+
+		std::sort(sorted.begin(), sorted.end());
+		auto at = [&](double q) { return static_cast<double>(sorted[static_cast<size_t>(q * (sorted.size() - 1) + 0.5)]); };
+		p.p50 = at(0.50);
+		p.p95 = at(0.95);
+		p.p99 = at(0.99);
+		p.max = sorted.back();
+		return p;
+	}
+
+	std::string report() const {
+		static const char* names[] = { "encode", "transport", "decode", "display", "end-to-end" };
+
+		std::string out = "Stream latency [ms] (p50 / p95 / p99 / max):\n";
+		char line[128];
+		for (size_t i = 0; i < static_cast<size_t>(StreamStage::Count); i++) {
+			Percentiles p = percentiles(static_cast<StreamStage>(i));
+			std::snprintf(line, sizeof(line), "  %-10s %7.2f %7.2f %7.2f %7.2f  (%zu samples)\n", names[i], p.p50, p.p95, p.p99, p.max, p.samples);
+			out += line;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		std::snprintf(line, sizeof(line), "  dropped late frames: %zu\n", drops);
+		out += line;
+		return out;
+	}
+
+private:
+	struct Stage {
+		std::vector<float> samples;
+		size_t next = 0;
+	};
+
+	size_t window;
+	Stage stages[static_cast<size_t>(StreamStage::Count)];
+	size_t drops = 0;
+	mutable std::mutex mutex;
+};
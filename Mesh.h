@@ -2,22 +2,124 @@
 
 #include <string>
 #include <vector>
+#include <memory>
 
+#define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm.hpp> 
 #include <glm/ext.hpp>
-#include "stb_image.h"
+#include <glm/gtx/euler_angles.hpp>
 
 #include "Vertex.h"
 #include "ShaderProgram.h"
+#include "ObjectBuffer.h"
+#include "Texture.h"
+#include "Bounds.h"
 
 
+// GPU buffers of a mesh, shared by all copies of the Mesh and deleted with the last one
+struct MeshGeometry {
+	// OpenGL buffer IDs
+	// ID = 0 is reserved (i.e. uninitalized)
+	GLuint VAO = 0;
+	GLuint VBO = 0;
+	GLuint EBO = 0;
+
+	GLsizei vertexCount = 0;
+	GLsizei indexCount = 0;
+	GLenum indexType = GL_UNSIGNED_INT; // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+
+	AABB bounds; // in mesh space
+
+	// 16-bit indices are used whenever the vertex count allows it
+	MeshGeometry(std::vector<Vertex> const& vertices, std::vector<GLuint> const& indices) {
+		if (vertices.size() <= 0x10000) {
+			std::vector<GLushort> shortIndices(indices.begin(), indices.end());
+			setup(vertices.data(), vertices.size(), shortIndices.data(), shortIndices.size(), GL_UNSIGNED_SHORT);
+		} else {
+			setup(vertices.data(), vertices.size(), indices.data(), indices.size(), GL_UNSIGNED_INT);
+		}
+	}
+
+	// upload straight from memory (e.g. a mapped file), indices are GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	MeshGeometry(const Vertex* vertices, size_t vertexCount, const void* indices, size_t indexCount, GLenum indexType) {
+		setup(vertices, vertexCount, indices, indexCount, indexType);
+	}
+
+	// take ownership of already filled vertex and index buffers
+	MeshGeometry(GLuint vbo, GLuint ebo, size_t vertexCount, size_t indexCount, GLenum indexType, const AABB& bounds) :
+		VBO(vbo), EBO(ebo), vertexCount(static_cast<GLsizei>(vertexCount)), indexCount(static_cast<GLsizei>(indexCount)), indexType(indexType), bounds(bounds) {
+		setupVertexArray();
+	}
+
+	MeshGeometry(const MeshGeometry&) = delete;
+	MeshGeometry& operator=(const MeshGeometry&) = delete;
+
+	~MeshGeometry() {
+		// Delete OpenGL buffers if they exist
+		if (VBO != 0) {
+			glDeleteBuffers(1, &VBO);
+			VBO = 0;
+		}
+		if (EBO != 0) {
+			glDeleteBuffers(1, &EBO);
+			EBO = 0;
+		}
+		if (VAO != 0) {
+			glDeleteVertexArrays(1, &VAO);
+			VAO = 0;
+		}
+	}
+
+private:
+	void setup(const Vertex* vertices, size_t vertexCount, const void* indices, size_t indexCount, GLenum indexType) {
+		this->vertexCount = static_cast<GLsizei>(vertexCount);
+		this->indexCount = static_cast<GLsizei>(indexCount);
+		this->indexType = indexType;
+		bounds = AABB::fromVertices(vertices, vertexCount);
+		size_t indexSize = (indexType == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLuint);
+
+		// direct state access, the element buffer must not be bound without a VAO
+		glCreateBuffers(1, &VBO);
+		glNamedBufferData(VBO, vertexCount * sizeof(Vertex), vertices, GL_STATIC_DRAW);
+
+		glCreateBuffers(1, &EBO);
+		glNamedBufferData(EBO, indexCount * indexSize, indices, GL_STATIC_DRAW);
+
+		setupVertexArray();
+	}
+
+	void setupVertexArray() {
+		glGenVertexArrays(1, &VAO);
+		glBindVertexArray(VAO);
+
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+			(void*)offsetof(Vertex, position));
+		glEnableVertexAttribArray(0);
+
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+			(void*)offsetof(Vertex, normal));
+		glEnableVertexAttribArray(1);
+
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+			(void*)offsetof(Vertex, texCoords));
+		glEnableVertexAttribArray(2);
+
+		glBindVertexArray(0);
+	};
+};
+
+
+// Mesh is cheap to copy: geometry and texture are shared, origin/orientation/material are per copy.
 class Mesh {
 public:
 	// mesh data
 	glm::vec3 origin{};
 	glm::vec3 orientation{};
 
-	GLuint texture_id{ 0 }; // texture id=0  means no texture
+	std::shared_ptr<Texture> texture; // nullptr means no texture
 	GLenum primitive_type = GL_POINT;
 	ShaderProgram& shader;
 
@@ -28,62 +130,22 @@ public:
 	float shininess{ 1.0f };
 
 	// indirect (indexed) draw 
-	Mesh(GLenum primitive_type, ShaderProgram& shader, std::vector<Vertex> const& vertices, std::vector<GLuint> const& indices, glm::vec3 const& origin, glm::vec3 const& orientation, GLuint const texture_id = 0) :
-		primitive_type(primitive_type),
-		shader(shader),
-		vertices(vertices),
-		indices(indices),
+	Mesh(GLenum primitive_type, ShaderProgram& shader, std::vector<Vertex> const& vertices, std::vector<GLuint> const& indices, glm::vec3 const& origin, glm::vec3 const& orientation, std::shared_ptr<Texture> texture = nullptr) :
+		Mesh(primitive_type, shader, std::make_shared<MeshGeometry>(vertices, indices), origin, orientation, std::move(texture)) {
+	};
+
+	// share already uploaded geometry
+	Mesh(GLenum primitive_type, ShaderProgram& shader, std::shared_ptr<const MeshGeometry> geometry, glm::vec3 const& origin, glm::vec3 const& orientation, std::shared_ptr<Texture> texture = nullptr) :
 		origin(origin),
 		orientation(orientation),
-		texture_id(texture_id) {
-		setupMesh();
+		texture(std::move(texture)),
+		primitive_type(primitive_type),
+		shader(shader),
+		geometry(std::move(geometry)) {
 	};
 
-    Mesh(Mesh&& other) noexcept : 
-        VAO(other.VAO),
-        VBO(other.VBO),
-        EBO(other.EBO),
-        vertices(std::move(other.vertices)),
-        indices(std::move(other.indices)),
-        origin(other.origin),
-        orientation(other.orientation),
-        texture_id(other.texture_id),
-        primitive_type(other.primitive_type),
-        shader(other.shader),
-        ambient_material(other.ambient_material),
-        diffuse_material(other.diffuse_material),
-        specular_material(other.specular_material),
-        shininess(other.shininess) {
-            other.VAO = 0;
-            other.VBO = 0;
-            other.EBO = 0;
-            other.texture_id = 0;
-        }
-
-	Mesh& operator=(Mesh&& other) noexcept {
-		if (this != &other) {
-			clear();
-			VAO = other.VAO;
-			VBO = other.VBO;
-			EBO = other.EBO;
-			vertices = std::move(other.vertices);
-			indices = std::move(other.indices);
-			origin = other.origin;
-			orientation = other.orientation;
-			texture_id = other.texture_id;
-			primitive_type = other.primitive_type;
-			shader = other.shader;
-			ambient_material = other.ambient_material;
-			diffuse_material = other.diffuse_material;
-			specular_material = other.specular_material;
-			shininess = other.shininess;
-			other.VAO = 0;
-			other.VBO = 0;
-			other.EBO = 0;
-			other.texture_id = 0;
-		}
-		return *this;
-	}
+	Mesh(const Mesh& other) = default;
+	Mesh(Mesh&& other) noexcept = default;
 
 	~Mesh() {
 		clear();
@@ -91,53 +153,91 @@ public:
 
 
 	void draw(glm::vec3 const& offset, glm::vec3 const& rotation) const {
-		if (VAO == 0) {
+		GLint objectIndex = gObjectBuffer.push(ObjectBlock{ makeTransform(origin + offset, rotation), getMaterialBlock() });
+		if (objectIndex < 0)
+			return;
+
+		drawInstanced(static_cast<GLuint>(objectIndex), 1);
+	}
+
+	// draw instanceCount instances whose ObjectBlocks start at firstObject in gObjectBuffer
+	void drawInstanced(GLuint firstObject, GLsizei instanceCount) const {
+		if (getVAO() == 0) {
 			std::cerr << "VAO not initialized!\n";
 			return;
 		}
 
 		shader.activate();
 
-		glm::mat4 model = glm::mat4(1.0f);
-		model = glm::translate(model, origin + offset);
-		model = glm::rotate(model, glm::radians(rotation.x), glm::vec3(1, 0, 0));
-		model = glm::rotate(model, glm::radians(rotation.y), glm::vec3(0, 1, 0));
-		model = glm::rotate(model, glm::radians(rotation.z), glm::vec3(0, 0, 1));
+		// Bind texture if available
+		GLuint texture_id = getTextureID();
+		if (texture_id > 0) {
+			glActiveTexture(GL_TEXTURE0); // Activate texture unit 0
+			glBindTexture(GL_TEXTURE_2D, texture_id);
+		}
 
+		// Bind VAO and draw, baseInstance selects the first ObjectBlock
+		glBindVertexArray(geometry->VAO);
+		glDrawElementsInstancedBaseInstance(primitive_type, geometry->indexCount, geometry->indexType, 0, instanceCount, firstObject);
+		glBindVertexArray(0);
 
-		// Set transformation matrix uniform
-		shader.setUniform("model", model);
+		// Unbind texture
+		if (texture_id > 0) {
+			glBindTexture(GL_TEXTURE_2D, 0);
+		}
+	}
 
-		// Set material properties
-		shader.setUniform("material.ambient", ambient_material);
-		shader.setUniform("material.diffuse", diffuse_material);
-		shader.setUniform("material.specular", specular_material);
-		shader.setUniform("material.shininess", shininess);
+	// draw with a DrawElementsIndirectCommand stored at offset in indirectBuffer, the command's
+	// baseInstance indexes the ObjectBlock buffer bound at the time of the draw
+	void drawIndirect(GLuint indirectBuffer, GLintptr offset) const {
+		if (getVAO() == 0) {
+			std::cerr << "VAO not initialized!\n";
+			return;
+		}
 
-		// Bind texture if available
+		shader.activate();
+
+		GLuint texture_id = getTextureID();
 		if (texture_id > 0) {
-			glActiveTexture(GL_TEXTURE0); // Activate texture unit 0
+			glActiveTexture(GL_TEXTURE0);
 			glBindTexture(GL_TEXTURE_2D, texture_id);
-			shader.setUniform("material.hasTexture", 1);
-			shader.setUniform("texture_diffuse1", 0); // Texture unit 0
-		} else {
-			shader.setUniform("material.hasTexture", 0);
 		}
 
-		// Bind VAO and draw
-		glBindVertexArray(VAO);
-		glDrawElements(primitive_type, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
+		glBindVertexArray(geometry->VAO);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		glDrawElementsIndirect(primitive_type, geometry->indexType, reinterpret_cast<const void*>(offset));
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
 		glBindVertexArray(0);
 
-		// Unbind texture
 		if (texture_id > 0) {
 			glBindTexture(GL_TEXTURE_2D, 0);
 		}
 	}
 
+	// translation followed by X, Y, Z rotation in degrees (same as three glm::rotate calls)
+	static glm::mat4 makeTransform(glm::vec3 const& position, glm::vec3 const& rotation) {
+		glm::mat4 model = glm::eulerAngleXYZ(glm::radians(rotation.x), glm::radians(rotation.y), glm::radians(rotation.z));
+		model[3] = glm::vec4(position, 1.0f);
+		return model;
+	}
+
+	GLuint getVAO() const { return geometry ? geometry->VAO : 0; }
+	GLuint getTextureID() const { return texture ? texture->id : 0; }
+	const std::shared_ptr<const MeshGeometry>& getGeometry() const { return geometry; }
+	AABB getBounds() const { return geometry ? geometry->bounds : AABB{}; }
+
+	MaterialBlock getMaterialBlock() const {
+		MaterialBlock material{};
+		material.ambient = ambient_material;
+		material.diffuse = diffuse_material;
+		material.specular = specular_material;
+		material.shininess = shininess;
+		material.hasTexture = getTextureID() > 0 ? 1 : 0;
+		return material;
+	}
 
 	void clear(void) {
-		texture_id = 0;
+		texture.reset();
 		primitive_type = GL_POINT;
 		origin = glm::vec3(0.0f);
 		orientation = glm::vec3(0.0f);
@@ -145,62 +245,13 @@ public:
 		diffuse_material = glm::vec4(1.0f);
 		specular_material = glm::vec4(1.0f);
 		shininess = 1.0f;
-		vertices.clear();
-		indices.clear();
 
-		// Delete OpenGL buffers if they exist
-		if (VBO != 0) {
-			glDeleteBuffers(1, &VBO);
-			VBO = 0;
-		}
-		if (EBO != 0) {
-			glDeleteBuffers(1, &EBO);
-			EBO = 0;
-		}
-		if (VAO != 0) {
-			glDeleteVertexArrays(1, &VAO);
-			VAO = 0;
-		}
+		// GL buffers are released together with the last reference to the geometry
+		geometry.reset();
 	};
 
 private:
-	// OpenGL buffer IDs
-	// ID = 0 is reserved (i.e. uninitalized)
-	unsigned int VAO = 0;
-	unsigned int VBO = 0;
-	unsigned int EBO = 0;
-
-	std::vector<Vertex> vertices;
-	std::vector<GLuint> indices;
-
-	void setupMesh() {
-		glGenVertexArrays(1, &VAO);
-		glBindVertexArray(VAO);
-
-		glGenBuffers(1, &VBO);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex),
-			vertices.data(), GL_STATIC_DRAW);
-
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-			(void*)offsetof(Vertex, position));
-		glEnableVertexAttribArray(0);
-
-		glGenBuffers(1, &EBO);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint),
-			indices.data(), GL_STATIC_DRAW);
-
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-			(void*)offsetof(Vertex, normal));
-		glEnableVertexAttribArray(1);
-
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-			(void*)offsetof(Vertex, texCoords));
-		glEnableVertexAttribArray(2);
-
-		glBindVertexArray(0);
-	};
+	std::shared_ptr<const MeshGeometry> geometry;
 };
 
 
@@ -0,0 +1,425 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "MeshCache.h"
+#include "AssetCache.h"
+
+namespace {
+
+constexpr char MAGIC[4] = { 'I', 'C', 'P', 'M' };
+constexpr std::uint32_t VERSION = 2;
+constexpr std::uint64_t DATA_ALIGNMENT = 16;
+
+struct Header {
+	char magic[4];
+	std::uint32_t version;
+	std::uint64_t sourceSize;
+	std::int64_t sourceTime;
+	std::uint32_t meshCount;
+	std::uint32_t vertexSize;
+	std::uint32_t materialFileCount;
+	std::uint32_t pad;
+};
+
+// one per mtllib of the source, materials and texture names come from these
+struct MaterialFile {
+	std::uint64_t nameOffset;
+	std::uint32_t nameLength;
+	std::uint32_t pad;
+	std::uint64_t size;		// 0 and 0 when the file was missing
+	std::int64_t time;
+};
+
+// one per mesh, offsets are from the start of the file
+struct Entry {
+	std::uint64_t vertexOffset;
+	std::uint64_t indexOffset;
+	std::uint64_t textureOffset;
+	std::uint32_t vertexCount;
+	std::uint32_t indexCount;
+	std::uint32_t indexSize; // 2 or 4 bytes
+	std::uint32_t textureLength;
+	float ambient[4];
+	float diffuse[4];
+	float specular[4];
+	float shininess;
+	std::uint32_t pad;
+};
+
+std::uint64_t alignUp(std::uint64_t offset) {
+	return (offset + DATA_ALIGNMENT - 1) & ~(DATA_ALIGNMENT - 1);
+}
+
+// identifies the source version the cache was built from
+bool sourceStamp(const std::filesystem::path& source, std::uint64_t& size, std::int64_t& time) {
+	std::error_code ec;
+	size = std::filesystem::file_size(source, ec);
+	if (ec)
+		return false;
+	auto writeTime = std::filesystem::last_write_time(source, ec);
+	if (ec)
+		return false;
+	time = static_cast<std::int64_t>(writeTime.time_since_epoch().count());
+	return true;
+}
+
+// material libraries named by the OBJ, relative to its directory
+std::vector<std::string> materialLibraries(const std::filesystem::path& source) {
+	std::vector<std::string> names;
+	std::ifstream in(source);
+	std::string line;
+	while (std::getline(in, line)) {
+		if (line.size() < 7 || line.compare(0, 6, "mtllib") != 0 || !std::isspace(static_cast<unsigned char>(line[6])))
+			continue;
+		std::istringstream words(line.substr(7));
+		std::string name;
+		while (words >> name)
+			names.push_back(name);
+	}
+	return names;
+}
+
+void materialStamp(const std::filesystem::path& file, std::uint64_t& size, std::int64_t& time) {
+	if (!sourceStamp(file, size, time)) {
+		size = 0;
+		time = 0;
+	}
+}
+
+template<class Index>
+bool indicesInRange(const unsigned char* data, std::uint32_t count, std::uint32_t vertexCount) {
+	const Index* indices = reinterpret_cast<const Index*>(data);
+	return std::all_of(indices, indices + count, [vertexCount](Index index) { return index < vertexCount; });
+}
+
+// read-only mapping of a whole file
+class MappedFile {
+public:
+	explicit MappedFile(const std::filesystem::path& path) {
+#ifdef _WIN32
+		file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return;
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+			return;
+		mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr)
+			return;
+		data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (data != nullptr)
+			size = static_cast<size_t>(fileSize.QuadPart);
+#else
+		fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return;
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0)
+			return;
+		void* ptr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		if (ptr == MAP_FAILED)
+			return;
+		data = static_cast<const unsigned char*>(ptr);
+		size = static_cast<size_t>(st.st_size);
+#endif
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile() {
+#ifdef _WIN32
+		if (data != nullptr)
+			UnmapViewOfFile(data);
+		if (mapping != nullptr)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+#else
+		if (data != nullptr)
+			munmap(const_cast<unsigned char*>(data), size);
+		if (fd >= 0)
+			close(fd);
+#endif
+	}
+
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+
+private:
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+};
+
+bool inRange(const MappedFile& file, std::uint64_t offset, std::uint64_t bytes) {
+	return offset <= file.size && bytes <= file.size - offset;
+}
+
+}
+
+std::filesystem::path MeshCache::cachePath(const std::filesystem::path& source) {
+	std::filesystem::path path = source;
+	path += ".meshbin";
+	return path;
+}
+
+namespace {
+
+// maps the cache of the source and validates it, false when missing, stale or corrupted
+bool openCache(const std::filesystem::path& source, MappedFile& file, std::vector<Entry>& entries) {
+	std::uint64_t sourceSize;
+	std::int64_t sourceTime;
+	if (!sourceStamp(source, sourceSize, sourceTime))
+		return false;
+
+	if (file.data == nullptr || file.size < sizeof(Header))
+		return false;
+
+	Header header;
+	std::memcpy(&header, file.data, sizeof(Header));
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+		|| header.version != VERSION
+		|| header.vertexSize != sizeof(Vertex)
+		|| header.sourceSize != sourceSize
+		|| header.sourceTime != sourceTime)
+		return false;
+
+	std::uint64_t materialsOffset = sizeof(Header) + std::uint64_t(header.meshCount) * sizeof(Entry);
+	if (!inRange(file, sizeof(Header), std::uint64_t(header.meshCount) * sizeof(Entry))
+		|| !inRange(file, materialsOffset, std::uint64_t(header.materialFileCount) * sizeof(MaterialFile)))
+		return false;
+
+	// an edited .mtl changes colours and textures without touching the OBJ
+	std::filesystem::path baseDir = source.parent_path();
+	for (std::uint32_t i = 0; i < header.materialFileCount; i++) {
+		MaterialFile material;
+		std::memcpy(&material, file.data + materialsOffset + i * sizeof(MaterialFile), sizeof(MaterialFile));
+		if (!inRange(file, material.nameOffset, material.nameLength))
+			return false;
+
+		std::string name(reinterpret_cast<const char*>(file.data + material.nameOffset), material.nameLength);
+		std::uint64_t size;
+		std::int64_t time;
+		materialStamp(baseDir / name, size, time);
+		if (size != material.size || time != material.time)
+			return false;
+	}
+
+	// validate everything before the first upload, a truncated cache must not leave half a model
+	entries.resize(header.meshCount);
+	std::memcpy(entries.data(), file.data + sizeof(Header), entries.size() * sizeof(Entry));
+	for (auto const& entry : entries) {
+		if ((entry.indexSize != 2 && entry.indexSize != 4)
+			|| !inRange(file, entry.vertexOffset, std::uint64_t(entry.vertexCount) * sizeof(Vertex))
+			|| !inRange(file, entry.indexOffset, std::uint64_t(entry.indexCount) * entry.indexSize)
+			|| !inRange(file, entry.textureOffset, entry.textureLength))
+			return false;
+
+		// the indices go to the GPU as they are, one past the vertices would read out of bounds
+		const unsigned char* indices = file.data + entry.indexOffset;
+		if (entry.indexSize == 2 ? !indicesInRange<std::uint16_t>(indices, entry.indexCount, entry.vertexCount)
+			: !indicesInRange<std::uint32_t>(indices, entry.indexCount, entry.vertexCount))
+			return false;
+	}
+
+	return true;
+}
+
+}
+
+bool MeshCache::load(const std::filesystem::path& source, ShaderProgram& shader, bool flipTextureYAxis, std::vector<Mesh>& meshes) {
+	MappedFile file(cachePath(source));
+	std::vector<Entry> entries;
+	if (!openCache(source, file, entries))
+		return false;
+
+	std::filesystem::path baseDir = source.parent_path();
+	meshes.reserve(meshes.size() + entries.size());
+
+	for (auto const& entry : entries) {
+		auto geometry = std::make_shared<MeshGeometry>(
+			reinterpret_cast<const Vertex*>(file.data + entry.vertexOffset), entry.vertexCount,
+			file.data + entry.indexOffset, entry.indexCount,
+			entry.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT);
+
+		std::shared_ptr<Texture> texture;
+		if (entry.textureLength > 0) {
+			std::string texturePath(reinterpret_cast<const char*>(file.data + entry.textureOffset), entry.textureLength);
+			texture = gAssetCache.getTexture(baseDir / texturePath, flipTextureYAxis);
+		}
+
+		Mesh mesh(GL_TRIANGLES, shader, geometry, glm::vec3(0.0f), glm::vec3(0.0f), texture);
+		mesh.ambient_material = glm::vec4(entry.ambient[0], entry.ambient[1], entry.ambient[2], entry.ambient[3]);
+		mesh.diffuse_material = glm::vec4(entry.diffuse[0], entry.diffuse[1], entry.diffuse[2], entry.diffuse[3]);
+		mesh.specular_material = glm::vec4(entry.specular[0], entry.specular[1], entry.specular[2], entry.specular[3]);
+		mesh.shininess = entry.shininess;
+
+		meshes.push_back(std::move(mesh));
+	}
+
+	std::cout << "Loaded " << entries.size() << " meshes of " << source.filename().string() << " from cache\n";
+	return true;
+}
+
+bool MeshCache::read(const std::filesystem::path& source, std::vector<MeshData>& meshes) {
+	MappedFile file(cachePath(source));
+	std::vector<Entry> entries;
+	if (!openCache(source, file, entries))
+		return false;
+
+	meshes.resize(entries.size());
+	for (size_t i = 0; i < entries.size(); i++) {
+		Entry const& entry = entries[i];
+		MeshData& mesh = meshes[i];
+
+		const Vertex* vertices = reinterpret_cast<const Vertex*>(file.data + entry.vertexOffset);
+		mesh.vertices.assign(vertices, vertices + entry.vertexCount);
+
+		mesh.indices.resize(entry.indexCount);
+		if (entry.indexSize == 2) {
+			const std::uint16_t* indices = reinterpret_cast<const std::uint16_t*>(file.data + entry.indexOffset);
+			std::copy(indices, indices + entry.indexCount, mesh.indices.begin());
+		}
+		else {
+			std::memcpy(mesh.indices.data(), file.data + entry.indexOffset, entry.indexCount * sizeof(GLuint));
+		}
+
+		mesh.ambient = glm::vec4(entry.ambient[0], entry.ambient[1], entry.ambient[2], entry.ambient[3]);
+		mesh.diffuse = glm::vec4(entry.diffuse[0], entry.diffuse[1], entry.diffuse[2], entry.diffuse[3]);
+		mesh.specular = glm::vec4(entry.specular[0], entry.specular[1], entry.specular[2], entry.specular[3]);
+		mesh.shininess = entry.shininess;
+		mesh.texturePath.assign(reinterpret_cast<const char*>(file.data + entry.textureOffset), entry.textureLength);
+	}
+
+	return true;
+}
+
+bool MeshCache::write(const std::filesystem::path& source, std::vector<MeshData> const& meshes) {
+	Header header{};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.meshCount = static_cast<std::uint32_t>(meshes.size());
+	header.vertexSize = sizeof(Vertex);
+	if (!sourceStamp(source, header.sourceSize, header.sourceTime))
+		return false;
+
+	std::vector<std::string> materialNames = materialLibraries(source);
+	header.materialFileCount = static_cast<std::uint32_t>(materialNames.size());
+
+	// layout: header, entries, material files, their names, texture names, then aligned vertex/index blocks
+	std::vector<Entry> entries(meshes.size());
+	std::vector<MaterialFile> materials(materialNames.size());
+	std::uint64_t offset = sizeof(Header) + entries.size() * sizeof(Entry) + materials.size() * sizeof(MaterialFile);
+
+	std::filesystem::path baseDir = source.parent_path();
+	for (size_t i = 0; i < materials.size(); i++) {
+		MaterialFile& material = materials[i];
+		material = MaterialFile{};
+		material.nameOffset = offset;
+		material.nameLength = static_cast<std::uint32_t>(materialNames[i].size());
+		materialStamp(baseDir / materialNames[i], material.size, material.time);
+		offset += material.nameLength;
+	}
+
+	for (size_t i = 0; i < meshes.size(); i++) {
+		auto const& mesh = meshes[i];
+		Entry& entry = entries[i];
+		entry = Entry{};
+
+		entry.textureOffset = offset;
+		entry.textureLength = static_cast<std::uint32_t>(mesh.texturePath.size());
+		offset += entry.textureLength;
+
+		for (int c = 0; c < 4; c++) {
+			entry.ambient[c] = mesh.ambient[c];
+			entry.diffuse[c] = mesh.diffuse[c];
+			entry.specular[c] = mesh.specular[c];
+		}
+		entry.shininess = mesh.shininess;
+	}
+
+	for (size_t i = 0; i < meshes.size(); i++) {
+		auto const& mesh = meshes[i];
+		Entry& entry = entries[i];
+
+		entry.vertexCount = static_cast<std::uint32_t>(mesh.vertices.size());
+		entry.indexCount = static_cast<std::uint32_t>(mesh.indices.size());
+		entry.indexSize = mesh.vertices.size() <= 0x10000 ? 2 : 4;
+
+		entry.vertexOffset = offset = alignUp(offset);
+		offset += std::uint64_t(entry.vertexCount) * sizeof(Vertex);
+		entry.indexOffset = offset = alignUp(offset);
+		offset += std::uint64_t(entry.indexCount) * entry.indexSize;
+	}
+
+	std::vector<char> bytes(offset, 0);
+	std::memcpy(bytes.data(), &header, sizeof(Header));
+	std::memcpy(bytes.data() + sizeof(Header), entries.data(), entries.size() * sizeof(Entry));
+	std::memcpy(bytes.data() + sizeof(Header) + entries.size() * sizeof(Entry), materials.data(), materials.size() * sizeof(MaterialFile));
+	for (size_t i = 0; i < materials.size(); i++)
+		std::memcpy(bytes.data() + materials[i].nameOffset, materialNames[i].data(), materials[i].nameLength);
+
+	for (size_t i = 0; i < meshes.size(); i++) {
+		auto const& mesh = meshes[i];
+		Entry const& entry = entries[i];
+
+		std::memcpy(bytes.data() + entry.textureOffset, mesh.texturePath.data(), entry.textureLength);
+		std::memcpy(bytes.data() + entry.vertexOffset, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+
+		if (entry.indexSize == 2) {
+			auto* indices = reinterpret_cast<std::uint16_t*>(bytes.data() + entry.indexOffset);
+			for (size_t j = 0; j < mesh.indices.size(); j++)
+				indices[j] = static_cast<std::uint16_t>(mesh.indices[j]);
+		}
+		else {
+			std::memcpy(bytes.data() + entry.indexOffset, mesh.indices.data(), mesh.indices.size() * sizeof(GLuint));
+		}
+	}
+
+	// write to a temporary file first, a crash must not leave a truncated cache behind. Loads of the
+	// same source (e.g. flipped and not) may write at once, each gets its own file and the last rename wins
+	static std::atomic<unsigned> writeCounter{ 0 };
+	std::filesystem::path path = cachePath(source);
+	std::filesystem::path tmpPath = path;
+	tmpPath += '.' + std::to_string(writeCounter++) + ".tmp";
+	{
+		std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+		if (!out || !out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()))) {
+			std::cerr << "Failed to write mesh cache: " << tmpPath.string() << '\n';
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tmpPath, path, ec);
+	if (ec) {
+		std::cerr << "Failed to write mesh cache: " << path.string() << " (" << ec.message() << ")\n";
+		std::filesystem::remove(tmpPath, ec);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+
+#include "Mesh.h"
+#include "MeshData.h"
+#include "ShaderProgram.h"
+
+// Binary cache of parsed OBJ models, stored next to the source as "<file>.meshbin".
+// The cache is memory mapped and its interleaved vertices and 16/32-bit indices are
+// handed to glBufferData directly. It is rebuilt when the size or mtime of the source or
+// of one of its .mtl files changes.
+class MeshCache {
+public:
+	static std::filesystem::path cachePath(const std::filesystem::path& source);
+
+	// false when there is no valid cache for the source, meshes are left untouched then
+	static bool load(const std::filesystem::path& source, ShaderProgram& shader, bool flipTextureYAxis, std::vector<Mesh>& meshes);
+
+	// CPU copy of a valid cache, does not touch OpenGL (used by worker threads)
+	static bool read(const std::filesystem::path& source, std::vector<MeshData>& meshes);
+
+	// failures are reported but not fatal, the model is simply parsed again next time
+	static bool write(const std::filesystem::path& source, std::vector<MeshData> const& meshes);
+};
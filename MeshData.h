@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Vertex.h"
+
+// CPU side of a mesh loaded from a file, before it is uploaded to the GPU
+struct MeshData {
+	std::vector<Vertex> vertices;
+	std::vector<GLuint> indices;
+
+	glm::vec4 ambient{ 1.0f };
+	glm::vec4 diffuse{ 1.0f };
+	glm::vec4 specular{ 1.0f };
+	float shininess{ 1.0f };
+	std::string texturePath; // relative to the model file, empty = no texture
+};
@@ -4,15 +4,41 @@
 #include <string>
 #include <vector> 
 #include <unordered_map>
+#define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm.hpp> 
+#include <glm/gtx/norm.hpp>
 
 #include "tiny_obj_loader.h"
 
 #include "Vertex.h"
 #include "Mesh.h"
 #include "ShaderProgram.h"
+#include "InstanceBatch.h"
+#include "AssetCache.h"
+#include "MeshData.h"
+#include "MeshCache.h"
 
 
+// tinyobj index triplet, used to merge identical face corners into one vertex
+struct ObjIndexKey {
+	int vertex_index;
+	int normal_index;
+	int texcoord_index;
+
+	bool operator==(const ObjIndexKey& other) const {
+		return vertex_index == other.vertex_index && normal_index == other.normal_index && texcoord_index == other.texcoord_index;
+	}
+};
+
+struct ObjIndexKeyHash {
+	size_t operator()(const ObjIndexKey& key) const {
+		size_t h = std::hash<int>()(key.vertex_index);
+		h ^= std::hash<int>()(key.normal_index) + 0x9e3779b9 + (h << 6) + (h >> 2);
+		h ^= std::hash<int>()(key.texcoord_index) + 0x9e3779b9 + (h << 6) + (h >> 2);
+		return h;
+	}
+};
+
 class Model {
 public:
 	std::vector<Mesh> meshes;
@@ -28,12 +54,32 @@ public:
 			indices,
 			glm::vec3(0.0f, 0.0f, 0.0f),
 			glm::vec3(0.0f, 0.0f, 0.0f),
-			0
+			nullptr
 		);
 		meshes.push_back(std::move(mesh));
 	}
 
+	// use gAssetCache.getModel() to share geometry and textures between models of the same file
 	Model(const std::filesystem::path& filename, ShaderProgram& shader, bool flipTextureYAxis = false) {
+		// an up-to-date binary cache is mapped and uploaded directly, no OBJ parsing
+		if (MeshCache::load(filename, shader, flipTextureYAxis, meshes))
+			return;
+
+		std::vector<MeshData> data = loadObj(filename);
+		MeshCache::write(filename, data);
+		createMeshes(data, filename.parent_path(), shader, flipTextureYAxis);
+	}
+
+	// upload already parsed meshes, texture paths are relative to baseDir
+	Model(std::vector<MeshData> const& data, const std::filesystem::path& baseDir, ShaderProgram& shader, bool flipTextureYAxis = false) {
+		createMeshes(data, baseDir, shader, flipTextureYAxis);
+	}
+
+	// meshes uploaded elsewhere (AssetLoader)
+	explicit Model(std::vector<Mesh>&& meshes) : meshes(std::move(meshes)) {}
+
+	// parse an OBJ file into CPU side meshes, does not touch OpenGL
+	static std::vector<MeshData> loadObj(const std::filesystem::path& filename) {
 		tinyobj::attrib_t attrib;
 		std::vector<tinyobj::shape_t> shapes;
 		std::vector<tinyobj::material_t> materials;
@@ -61,29 +107,71 @@ public:
 			throw std::runtime_error("Failed to load OBJ file: " + filename.string());
 		}
 
+		std::vector<MeshData> result;
+		result.reserve(shapes.size());
+
 		for (size_t s = 0; s < shapes.size(); s++) {
-			std::vector<Vertex> vertices;
-			std::vector<GLuint> indices;
+			MeshData mesh;
+
+			const auto& shapeIndices = shapes[s].mesh.indices;
+
+			// smooth normals for corners without a normal in the file, accumulated per position
+			// so that vertices split only by texture coordinates still shade continuously
+			std::vector<glm::vec3> generatedNormals;
+			for (size_t f = 0; f + 2 < shapeIndices.size(); f += 3) {
+				if (shapeIndices[f].normal_index >= 0 && shapeIndices[f + 1].normal_index >= 0 && shapeIndices[f + 2].normal_index >= 0)
+					continue;
+				if (generatedNormals.empty())
+					generatedNormals.resize(attrib.vertices.size() / 3, glm::vec3(0.0f));
+
+				int v0 = shapeIndices[f + 0].vertex_index;
+				int v1 = shapeIndices[f + 1].vertex_index;
+				int v2 = shapeIndices[f + 2].vertex_index;
+				if (v0 < 0 || v1 < 0 || v2 < 0)
+					continue;
+
+				glm::vec3 p0 = getObjPosition(attrib, v0);
+				glm::vec3 p1 = getObjPosition(attrib, v1);
+				glm::vec3 p2 = getObjPosition(attrib, v2);
+
+				// not normalized, larger faces weigh more
+				glm::vec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+				generatedNormals[v0] += faceNormal;
+				generatedNormals[v1] += faceNormal;
+				generatedNormals[v2] += faceNormal;
+			}
+
+			// every unique (position, normal, texcoord) triplet becomes one vertex
+			std::unordered_map<ObjIndexKey, GLuint, ObjIndexKeyHash> uniqueVertices;
+			uniqueVertices.reserve(shapeIndices.size());
+			mesh.indices.reserve(shapeIndices.size());
 
 			// shapes[s].mesh.indices = index triplets
-			for (size_t f = 0; f < shapes[s].mesh.indices.size(); f++) {
-				tinyobj::index_t idx = shapes[s].mesh.indices[f];
+			for (size_t f = 0; f < shapeIndices.size(); f++) {
+				tinyobj::index_t idx = shapeIndices[f];
+
+				ObjIndexKey key{ idx.vertex_index, idx.normal_index, idx.texcoord_index };
+				auto found = uniqueVertices.find(key);
+				if (found != uniqueVertices.end()) {
+					mesh.indices.push_back(found->second);
+					continue;
+				}
 
 				// Positions
 				glm::vec3 position(0.0f);
 				if (idx.vertex_index >= 0) {
-					position.x = attrib.vertices[3 * size_t(idx.vertex_index) + 0];
-					position.y = attrib.vertices[3 * size_t(idx.vertex_index) + 1];
-					position.z = attrib.vertices[3 * size_t(idx.vertex_index) + 2];
+					position = getObjPosition(attrib, idx.vertex_index);
 				}
 
 				// Normals
-				glm::vec3 normal(0.0f);
-				/*if (idx.normal_index >= 0) {
+				glm::vec3 normal(0.0f, 1.0f, 0.0f);
+				if (idx.normal_index >= 0) {
 					normal.x = attrib.normals[3 * size_t(idx.normal_index) + 0];
 					normal.y = attrib.normals[3 * size_t(idx.normal_index) + 1];
 					normal.z = attrib.normals[3 * size_t(idx.normal_index) + 2];
-				}*/
+				} else if (idx.vertex_index >= 0 && glm::length2(generatedNormals[idx.vertex_index]) > 0.0f) {
+					normal = glm::normalize(generatedNormals[idx.vertex_index]);
+				}
 
 				// Texture coordinates
 				glm::vec2 texCoords(0.0f);
@@ -97,75 +185,29 @@ public:
 				vertex.normal = normal;
 				vertex.texCoords = texCoords;
 
-				vertices.push_back(vertex);
-				indices.push_back(static_cast<GLuint>(vertices.size() - 1));
-
-				//std::cout << "Shape " << s << ": "
-				//	<< vertices.size() << " verts, "
-				//	<< indices.size() << " indices\n";
-			}
-
-			for (size_t i = 0; i + 2 < indices.size(); i += 3) {
-				GLuint i0 = indices[i + 0];
-				GLuint i1 = indices[i + 1];
-				GLuint i2 = indices[i + 2];
-
-				glm::vec3 p0 = vertices[i0].position;
-				glm::vec3 p1 = vertices[i1].position;
-				glm::vec3 p2 = vertices[i2].position;
-
-				glm::vec3 edge1 = p1 - p0;
-				glm::vec3 edge2 = p2 - p0;
-				glm::vec3 faceNormal = glm::normalize(glm::cross(edge1, edge2));
-
-				vertices[i0].normal = faceNormal;
-				vertices[i1].normal = faceNormal;
-				vertices[i2].normal = faceNormal;
+				GLuint index = static_cast<GLuint>(mesh.vertices.size());
+				mesh.vertices.push_back(vertex);
+				mesh.indices.push_back(index);
+				uniqueVertices.emplace(key, index);
 			}
 
-			glm::vec4 ambient(1.0f), diffuse(1.0f), specular(1.0f);
-			float shininess = 1.0f;
-			GLuint textureID = 0;
-
 			if (!shapes[s].mesh.material_ids.empty()) {
 				int matID = shapes[s].mesh.material_ids[0];
 				if (matID >= 0 && matID < static_cast<int>(materials.size())) {
 					const auto& mat = materials[matID];
 
-					ambient = glm::vec4(mat.ambient[0], mat.ambient[1], mat.ambient[2], 1.0f);
-					diffuse = glm::vec4(mat.diffuse[0], mat.diffuse[1], mat.diffuse[2], 1.0f);
-					specular = glm::vec4(mat.specular[0], mat.specular[1], mat.specular[2], 1.0f);
-					shininess = mat.shininess;
-
-					if (!mat.diffuse_texname.empty()) {
-						std::string texPath = base_dir + mat.diffuse_texname;
-						textureID = loadTextureFromFile(texPath, flipTextureYAxis);
-					}
+					mesh.ambient = glm::vec4(mat.ambient[0], mat.ambient[1], mat.ambient[2], 1.0f);
+					mesh.diffuse = glm::vec4(mat.diffuse[0], mat.diffuse[1], mat.diffuse[2], 1.0f);
+					mesh.specular = glm::vec4(mat.specular[0], mat.specular[1], mat.specular[2], 1.0f);
+					mesh.shininess = mat.shininess;
+					mesh.texturePath = mat.diffuse_texname;
 				}
 			}
 
-			Mesh mesh(
-				GL_TRIANGLES,
-				shader,
-				vertices,
-				indices,
-				glm::vec3(0.0f, 0.0f, 0.0f),
-				glm::vec3(0.0f, 0.0f, 0.0f),
-				textureID
-			);
-
-			mesh.ambient_material = ambient;
-			mesh.diffuse_material = diffuse;
-			mesh.specular_material = specular;
-			mesh.shininess = shininess;
-
-			/*mesh.ambient_material = glm::vec4(0.5f, 0.1f, 0.1f, 1.0f);
-			mesh.diffuse_material = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
-			mesh.specular_material = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
-			mesh.shininess = 32.0f;*/
-
-			meshes.push_back(std::move(mesh));
+			result.push_back(std::move(mesh));
 		}
+
+		return result;
 	}
 
 	void setAlpha(float alpha) {
@@ -187,44 +229,63 @@ public:
 		}
 	}
 
-	GLuint loadTextureFromFile(const std::string& path, bool flipYAxis) {
-		int width, height, nrChannels;
-		stbi_set_flip_vertically_on_load(flipYAxis);
-		unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrChannels, 0);
+	// model space bounds of all meshes, computed on demand because meshes can be swapped (AssetLoader)
+	AABB getBounds() const {
+		AABB bounds;
+		for (auto const& mesh : meshes) {
+			AABB meshBounds = mesh.getBounds();
+			if (meshBounds.valid()) {
+				meshBounds.min += mesh.origin;
+				meshBounds.max += mesh.origin;
+			}
+			bounds.expand(meshBounds);
+		}
+		return bounds;
+	}
+
+	void createMeshes(std::vector<MeshData> const& data, const std::filesystem::path& baseDir, ShaderProgram& shader, bool flipTextureYAxis) {
+		meshes.reserve(meshes.size() + data.size());
+
+		for (auto const& meshData : data) {
+			std::shared_ptr<Texture> texture;
+			if (!meshData.texturePath.empty()) {
+				texture = gAssetCache.getTexture(baseDir / meshData.texturePath, flipTextureYAxis);
+			}
 
-		if (!data) {
-			std::cerr << "Texture failed to load at path: " << path << std::endl;
-			return 0;
+			Mesh mesh(
+				GL_TRIANGLES,
+				shader,
+				meshData.vertices,
+				meshData.indices,
+				glm::vec3(0.0f, 0.0f, 0.0f),
+				glm::vec3(0.0f, 0.0f, 0.0f),
+				texture
+			);
+
+			mesh.ambient_material = meshData.ambient;
+			mesh.diffuse_material = meshData.diffuse;
+			mesh.specular_material = meshData.specular;
+			mesh.shininess = meshData.shininess;
+
+			meshes.push_back(std::move(mesh));
 		}
+	}
 
-		GLuint textureID;
-		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-
-		GLenum format = GL_RGB;
-		if (nrChannels == 1) format = GL_RED;
-		else if (nrChannels == 3) format = GL_RGB;
-		else if (nrChannels == 4) format = GL_RGBA;
-
-		glTexImage2D(GL_TEXTURE_2D,
-			0,                 // mipmap level
-			format,           // internal format
-			width, height,
-			0,                 // border
-			format,           // format of the source image
-			GL_UNSIGNED_BYTE,
-			data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		glBindTexture(GL_TEXTURE_2D, 0);
-		stbi_image_free(data);
-
-		return textureID;
+	static glm::vec3 getObjPosition(const tinyobj::attrib_t& attrib, int vertexIndex) {
+		return glm::vec3(
+			attrib.vertices[3 * size_t(vertexIndex) + 0],
+			attrib.vertices[3 * size_t(vertexIndex) + 1],
+			attrib.vertices[3 * size_t(vertexIndex) + 2]);
+	}
+
+	// queue all meshes into an instance batch, the transform is built once for the whole model
+	void submit(InstanceBatch& batch, glm::vec3 const& offset = glm::vec3(0.0), glm::vec3 const& rotation = glm::vec3(0.0f)) const {
+		glm::mat4 transform = Mesh::makeTransform(origin + offset, orientation + rotation);
+		for (auto const& mesh : meshes) {
+			glm::mat4 meshTransform = transform;
+			meshTransform[3] += glm::vec4(mesh.origin, 0.0f);
+			batch.add(mesh, meshTransform);
+		}
 	}
 };
 
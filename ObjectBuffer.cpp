@@ -0,0 +1,80 @@
+#include "ObjectBuffer.h"
+
+ObjectBuffer gObjectBuffer;
+
+void ObjectBuffer::init(GLuint capacity) {
+	GLint alignment = 1;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+	// every frame region has to start on a valid glBindBufferRange offset
+	regionCapacity = capacity;
+	regionSize = static_cast<GLsizeiptr>(capacity) * sizeof(ObjectBlock);
+	regionSize = (regionSize + alignment - 1) / alignment * alignment;
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	glBufferStorage(GL_SHADER_STORAGE_BUFFER, regionSize * FRAMES, nullptr, flags);
+	mapped = static_cast<unsigned char*>(glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, regionSize * FRAMES, flags));
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	if (!mapped)
+		throw std::runtime_error("Object buffer can not be mapped.");
+}
+
+void ObjectBuffer::destroy() {
+	for (auto& fence : fences) {
+		if (fence) {
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+
+	if (buffer != 0) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+		glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		glDeleteBuffers(1, &buffer);
+		buffer = 0;
+	}
+	mapped = nullptr;
+}
+
+void ObjectBuffer::beginFrame() {
+	frame = (frame + 1) % FRAMES;
+	cursor = 0;
+
+	// wait until the GPU is done with the region written FRAMES frames ago
+	if (fences[frame]) {
+		GLenum result = glClientWaitSync(fences[frame], 0, 0);
+		while (result == GL_TIMEOUT_EXPIRED)
+			result = glClientWaitSync(fences[frame], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+		glDeleteSync(fences[frame]);
+		fences[frame] = nullptr;
+	}
+
+	bind();
+}
+
+void ObjectBuffer::bind() const {
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, BINDING, buffer, regionSize * frame, regionSize);
+}
+
+void ObjectBuffer::endFrame() {
+	fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+ObjectBlock* ObjectBuffer::allocate(GLuint count, GLuint& firstIndex) {
+	if (!mapped || cursor + count > regionCapacity) {
+		if (!overflowReported) {
+			std::cerr << "Object buffer full (" << regionCapacity << " objects per frame), skipping draws.\n";
+			overflowReported = true;
+		}
+		return nullptr;
+	}
+
+	firstIndex = cursor;
+	cursor += count;
+	return reinterpret_cast<ObjectBlock*>(mapped + regionSize * frame) + firstIndex;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <iostream>
+
+#include <GL/glew.h>
+
+#include "RenderBlocks.h"
+
+// Persistently mapped ring of ObjectBlocks. Every frame gets its own region, so the CPU
+// never writes to data the GPU may still be reading. Draws reference their entry through
+// the baseInstance parameter, which makes consecutive entries usable for instanced draws.
+class ObjectBuffer {
+public:
+	static constexpr GLuint BINDING = 2;
+	static constexpr int FRAMES = 3;
+	static constexpr GLuint DEFAULT_CAPACITY = 16384; // objects per frame
+
+	void init(GLuint capacity = DEFAULT_CAPACITY);
+	void destroy();
+
+	void beginFrame();
+	void endFrame();
+
+	// binds the current frame region again after something else used BINDING
+	void bind() const;
+
+	// reserve count consecutive entries in the current frame, returns nullptr when full
+	ObjectBlock* allocate(GLuint count, GLuint& firstIndex);
+
+	// returns the index for gl_BaseInstance, -1 when full
+	GLint push(const ObjectBlock& object) {
+		GLuint index;
+		ObjectBlock* dst = allocate(1, index);
+		if (!dst)
+			return -1;
+		*dst = object;
+		return static_cast<GLint>(index);
+	}
+
+	GLuint used() const { return cursor; }
+	GLuint capacity() const { return regionCapacity; }
+
+private:
+	GLuint buffer = 0;
+	unsigned char* mapped = nullptr;
+	GLuint regionCapacity = 0;
+	GLsizeiptr regionSize = 0;
+	GLuint cursor = 0;
+	int frame = 0;
+	bool overflowReported = false;
+	GLsync fences[FRAMES] = {};
+};
+
+extern ObjectBuffer gObjectBuffer;
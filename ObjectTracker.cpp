@@ -0,0 +1,121 @@
+#include <algorithm>
+
+#include "ObjectTracker.h"
+
+cv::Point2f ObjectTracker::update(const cv::Mat& bgr) {
+	cv::Rect frame(0, 0, bgr.cols, bgr.rows);
+	cv::Point2f blobCenter;
+	cv::Rect blobBox;
+	bool found = false;
+
+	if (hasTrack) {
+		cv::Point2f expected = predict();
+		int marginX = std::max(minMargin, static_cast<int>(box.width * searchMargin));
+		int marginY = std::max(minMargin, static_cast<int>(box.height * searchMargin));
+		cv::Rect window(static_cast<int>(expected.x) - box.width / 2 - marginX, static_cast<int>(expected.y) - box.height / 2 - marginY,
+			box.width + 2 * marginX, box.height + 2 * marginY);
+		window = window & frame;
+
+		if (!window.empty() && search(bgr, window, blobCenter, blobBox)) {
+			// a blob cut by the window may continue outside of it, look at the whole frame then
+			bool clipped = (blobBox.x <= window.x && window.x > 0) || (blobBox.y <= window.y && window.y > 0) ||
+				(blobBox.x + blobBox.width >= window.x + window.width && window.x + window.width < frame.width) ||
+				(blobBox.y + blobBox.height >= window.y + window.height && window.y + window.height < frame.height);
+			found = !clipped;
+		}
+	}
+
+	if (!found) {
+		fullSearches++;
+		found = search(bgr, frame, blobCenter, blobBox);
+		// the prediction was wrong, start the filter again at the new position
+		kalmanReady = false;
+	}
+
+	if (!found) {
+		reset();
+		return cv::Point2f(0, 0);
+	}
+
+	hasTrack = true;
+	box = blobBox;
+	center = blobCenter;
+	correct(blobCenter);
+	return blobCenter;
+}
+
+void ObjectTracker::reset() {
+	hasTrack = false;
+	kalmanReady = false;
+	box = cv::Rect();
+}
+
+bool ObjectTracker::search(const cv::Mat& bgr, const cv::Rect& area, cv::Point2f& blobCenter, cv::Rect& blobBox) {
+	cv::Mat view = bgr(area);
+	cv::cvtColor(view, hsv, cv::COLOR_BGR2HSV);
+	cv::inRange(hsv, cv::Scalar(0, 100, 100), cv::Scalar(10, 255, 255), mask1);
+	cv::inRange(hsv, cv::Scalar(170, 100, 100), cv::Scalar(180, 255, 255), mask2);
+	cv::bitwise_or(mask1, mask2, mask);
+
+	// outer contours only, holes do not matter for the centroid; offset to frame coordinates
+	contours.clear();
+	cv::findContours(mask, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE, area.tl());
+	if (contours.empty())
+		return false;
+
+	size_t largest = 0;
+	double largestArea = 0.0;
+	for (size_t i = 0; i < contours.size(); i++) {
+		double a = cv::contourArea(contours[i]);
+		if (a > largestArea) {
+			largestArea = a;
+			largest = i;
+		}
+	}
+
+	cv::Moments mu = cv::moments(contours[largest]);
+	if (mu.m00 <= 0.0)
+		return false;
+
+	blobCenter = cv::Point2f(static_cast<float>(mu.m10 / mu.m00), static_cast<float>(mu.m01 / mu.m00));
+	blobBox = cv::boundingRect(contours[largest]);
+	return true;
+}
+
+cv::Point2f ObjectTracker::predict() {
+	if (!useKalman || !kalmanReady)
+		return center;
+
+	const cv::Mat& state = kalman.predict();
+	return cv::Point2f(state.at<float>(0, 0), state.at<float>(1, 0));
+}
+
+void ObjectTracker::correct(const cv::Point2f& measured) {
+	// switched off, the filter is seeded again once it is back on
+	if (!useKalman) {
+		kalmanReady = false;
+		return;
+	}
+
+	if (!kalmanReady) {
+		// state x, y, vx, vy in pixels and pixels per frame
+		kalman.init(4, 2, 0, CV_32F);
+		kalman.transitionMatrix = (cv::Mat_<float>(4, 4) <<
+			1, 0, 1, 0,
+			0, 1, 0, 1,
+			0, 0, 1, 0,
+			0, 0, 0, 1);
+		cv::setIdentity(kalman.measurementMatrix);
+		cv::setIdentity(kalman.processNoiseCov, cv::Scalar::all(1e-2));
+		cv::setIdentity(kalman.measurementNoiseCov, cv::Scalar::all(1.0));
+		cv::setIdentity(kalman.errorCovPost, cv::Scalar::all(1.0));
+		kalman.statePost = (cv::Mat_<float>(4, 1) << measured.x, measured.y, 0, 0);
+		kalmanReady = true;
+		return;
+	}
+
+	cv::Mat_<float> measurement(2, 1);
+	measurement(0, 0) = measured.x;
+	measurement(1, 0) = measured.y;
+	kalman.correct(measurement);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+
+#include <opencv2\opencv.hpp>
+
+// Follows the red object between frames. While the object is tracked, only a window around its
+// last (or Kalman-predicted) bounding box is thresholded, so the cost scales with the object and
+// not the frame. The whole frame is searched again when the object is lost or reaches the window
+// border. Not thread-safe, one tracker per processing thread.
+class ObjectTracker {
+public:
+	// predict the next position with a constant-velocity Kalman filter instead of reusing the last one
+	bool useKalman = false;
+	// the search window grows the last bounding box by this fraction of its size on every side...
+	float searchMargin = 0.75f;
+	// ...but at least by this many pixels
+	int minMargin = 24;
+
+	// centroid of the tracked object in pixels, (0, 0) when there is none
+	cv::Point2f update(const cv::Mat& bgr);
+
+	bool tracking() const { return hasTrack; }
+	const cv::Rect& bounds() const { return box; }
+	// forget the track, the next update searches the whole frame
+	void reset();
+
+	// full frame searches so far, for profiling
+	size_t fullSearches = 0;
+
+private:
+	bool hasTrack = false;
+	cv::Rect box;
+	cv::Point2f center;
+
+	cv::KalmanFilter kalman;
+	bool kalmanReady = false;
+
+	// reused between frames
+	cv::Mat hsv, mask1, mask2, mask;
+	std::vector<std::vector<cv::Point>> contours;
+
+	// largest red blob inside area, in frame coordinates
+	bool search(const cv::Mat& bgr, const cv::Rect& area, cv::Point2f& blobCenter, cv::Rect& blobBox);
+	cv::Point2f predict();
+	void correct(const cv::Point2f& measured);
+};
@@ -0,0 +1,119 @@
+#include <stdexcept>
+
+#include "OitBuffer.h"
+
+void OitBuffer::init() {
+	composite = ShaderProgram("oitCompositeVS.glsl", "oitCompositeFS.glsl");
+
+	// the full screen triangle comes from gl_VertexID, core profile still needs some VAO
+	glCreateVertexArrays(1, &emptyVAO);
+}
+
+void OitBuffer::destroy() {
+	destroyTargets();
+
+	if (emptyVAO != 0) {
+		glDeleteVertexArrays(1, &emptyVAO);
+		emptyVAO = 0;
+	}
+	composite.clear();
+}
+
+void OitBuffer::createTargets(int newWidth, int newHeight) {
+	destroyTargets();
+	width = newWidth;
+	height = newHeight;
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &sceneColor);
+	glTextureStorage2D(sceneColor, 1, GL_RGBA8, width, height);
+	glCreateTextures(GL_TEXTURE_2D, 1, &depth);
+	glTextureStorage2D(depth, 1, GL_DEPTH24_STENCIL8, width, height);
+	glCreateTextures(GL_TEXTURE_2D, 1, &accum);
+	glTextureStorage2D(accum, 1, GL_RGBA16F, width, height);
+	glCreateTextures(GL_TEXTURE_2D, 1, &revealage);
+	glTextureStorage2D(revealage, 1, GL_R8, width, height);
+
+	for (GLuint texture : { accum, revealage }) {
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+
+	glCreateFramebuffers(1, &sceneFBO);
+	glNamedFramebufferTexture(sceneFBO, GL_COLOR_ATTACHMENT0, sceneColor, 0);
+	glNamedFramebufferTexture(sceneFBO, GL_DEPTH_STENCIL_ATTACHMENT, depth, 0);
+
+	glCreateFramebuffers(1, &accumFBO);
+	glNamedFramebufferTexture(accumFBO, GL_COLOR_ATTACHMENT0, accum, 0);
+	glNamedFramebufferTexture(accumFBO, GL_COLOR_ATTACHMENT1, revealage, 0);
+	glNamedFramebufferTexture(accumFBO, GL_DEPTH_STENCIL_ATTACHMENT, depth, 0);
+	const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glNamedFramebufferDrawBuffers(accumFBO, 2, drawBuffers);
+
+	if (glCheckNamedFramebufferStatus(sceneFBO, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE ||
+		glCheckNamedFramebufferStatus(accumFBO, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		throw std::runtime_error("OIT framebuffer incomplete.");
+}
+
+void OitBuffer::destroyTargets() {
+	GLuint framebuffers[] = { sceneFBO, accumFBO };
+	glDeleteFramebuffers(2, framebuffers);
+	GLuint textures[] = { sceneColor, depth, accum, revealage };
+	glDeleteTextures(4, textures);
+
+	sceneFBO = accumFBO = 0;
+	sceneColor = depth = accum = revealage = 0;
+	width = height = 0;
+}
+
+void OitBuffer::beginScene(int newWidth, int newHeight) {
+	// a minimized window reports 0 x 0, keep the old targets until it comes back
+	if ((newWidth != width || newHeight != height) && newWidth > 0 && newHeight > 0)
+		createTargets(newWidth, newHeight);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+}
+
+void OitBuffer::beginTransparent(ShaderProgram& modelShader) {
+	glBindFramebuffer(GL_FRAMEBUFFER, accumFBO);
+	const GLfloat zero[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const GLfloat one[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	glClearBufferfv(GL_COLOR, 0, zero);
+	glClearBufferfv(GL_COLOR, 1, one);
+
+	// accum adds up, revealage multiplies by (1 - alpha)
+	glDepthMask(GL_FALSE);
+	glBlendFunci(0, GL_ONE, GL_ONE);
+	glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+
+	modelShader.activate();
+	if (!modelPassUniform.valid())
+		modelPassUniform = modelShader.getUniformHandle("oitPass");
+	modelShader.setUniform(modelPassUniform, 1);
+}
+
+void OitBuffer::endTransparent(ShaderProgram& modelShader) {
+	modelShader.activate();
+	modelShader.setUniform(modelPassUniform, 0);
+
+	// average colour over the pixel's transparent layers, blended over the opaque scene
+	glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDisable(GL_DEPTH_TEST);
+
+	composite.activate();
+	glBindTextureUnit(0, accum);
+	glBindTextureUnit(1, revealage);
+	glBindVertexArray(emptyVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+	glBindTextureUnit(0, 0);
+	glBindTextureUnit(1, 0);
+
+	glEnable(GL_DEPTH_TEST);
+	glDepthMask(GL_TRUE);
+}
+
+void OitBuffer::endScene() {
+	glBlitNamedFramebuffer(sceneFBO, 0, 0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
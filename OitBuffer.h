@@ -0,0 +1,43 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include "ShaderProgram.h"
+
+// Weighted blended order-independent transparency (McGuire & Bavoil). The frame is rendered
+// into an offscreen scene target, transparent surfaces are accumulated in any order into an
+// accumulation/revealage pair sharing its depth, and one full screen pass composites them.
+// The cost is fixed per pixel, nothing has to be sorted on the CPU.
+class OitBuffer {
+public:
+	// creates the composite program, targets are sized on the first beginScene()
+	void init();
+	void destroy();
+
+	// redirects the frame into the scene target, resized to width x height when needed
+	void beginScene(int width, int height);
+
+	// model shader switches to accumulation, draws may come in any order
+	void beginTransparent(ShaderProgram& modelShader);
+	void endTransparent(ShaderProgram& modelShader);
+
+	// copies the scene to the default framebuffer and binds it again
+	void endScene();
+
+private:
+	void createTargets(int width, int height);
+	void destroyTargets();
+
+	ShaderProgram composite;
+	UniformHandle modelPassUniform;
+	GLuint emptyVAO = 0;
+
+	int width = 0;
+	int height = 0;
+	GLuint sceneFBO = 0;
+	GLuint accumFBO = 0;
+	GLuint sceneColor = 0;
+	GLuint depth = 0;		// shared, transparent surfaces are tested against the opaque scene
+	GLuint accum = 0;		// sum of weighted premultiplied colour (rgb) and weighted alpha (a)
+	GLuint revealage = 0;	// product of (1 - alpha)
+};
@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "ParticleSystem.h"
+#include "Assets.h"
+#include "GpuParticles.h"
+#include "Model.h"
+#include "ObjectBuffer.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PARTICLE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace ParticleSystem {
+    namespace {
+        // live particles are [0, count)
+        struct Pool {
+            alignas(16) float px[CAPACITY];
+            alignas(16) float py[CAPACITY];
+            alignas(16) float pz[CAPACITY];
+            alignas(16) float vx[CAPACITY];
+            alignas(16) float vy[CAPACITY];
+            alignas(16) float vz[CAPACITY];
+            alignas(16) float life[CAPACITY];   // remaining seconds
+            alignas(16) float span[CAPACITY];   // total seconds
+            alignas(16) float r[CAPACITY];
+            alignas(16) float g[CAPACITY];
+            alignas(16) float b[CAPACITY];
+            size_t count = 0;
+        };
+
+        struct EmitterState {
+            int id;
+            Emitter emitter;
+            float pending = 0.0f;
+            float elapsed = 0.0f;
+        };
+
+        Pool pool;
+        GpuParticles gpu;
+        Backend activeBackend = Backend::Cpu;
+        std::vector<EmitterState> emitters;
+        int nextEmitterId = 0;
+
+        // one sphere shared by every particle
+        Model* particleModel = nullptr;
+
+        // xorshift, rand() is slow and not thread-safe
+        uint32_t rngState = 0x9E3779B9u;
+
+        float random01() {
+            rngState ^= rngState << 13;
+            rngState ^= rngState >> 17;
+            rngState ^= rngState << 5;
+            return (rngState >> 8) * (1.0f / 16777216.0f);
+        }
+
+        float randomRange(float lo, float hi) {
+            return lo + (hi - lo) * random01();
+        }
+
+        void ensureModel(ShaderProgram& shader) {
+            if (!particleModel) {
+                // white, the colour comes per particle
+                particleModel = new Model(Assets::createSphere(PARTICLE_RADIUS, 10, 10, glm::vec4(1.0f), shader));
+            }
+        }
+
+        void spawn(const glm::vec3& origin, float minSpeed, float maxSpeed, float minLifetime, float maxLifetime, const glm::vec3& color) {
+            if (activeBackend == Backend::Cpu && pool.count == CAPACITY)
+                return;
+
+            glm::vec3 dir(random01() * 2.0f - 1.0f, random01() * 2.0f - 1.0f, random01() * 2.0f - 1.0f);
+            float length = glm::length(dir);
+            dir = length < 0.001f ? glm::vec3(0.0f, 1.0f, 0.0f) : dir / length;
+            glm::vec3 velocity = dir * randomRange(minSpeed, maxSpeed);
+            float lifetime = randomRange(minLifetime, maxLifetime);
+
+            if (activeBackend == Backend::Gpu) {
+                gpu.spawn(origin, velocity, lifetime, color);
+                return;
+            }
+
+            size_t i = pool.count++;
+            pool.px[i] = origin.x;
+            pool.py[i] = origin.y;
+            pool.pz[i] = origin.z;
+            pool.vx[i] = velocity.x;
+            pool.vy[i] = velocity.y;
+            pool.vz[i] = velocity.z;
+            pool.life[i] = lifetime;
+            pool.span[i] = lifetime;
+            pool.r[i] = color.r;
+            pool.g[i] = color.g;
+            pool.b[i] = color.b;
+        }
+
+        void integrate(size_t begin, size_t end, float deltaTime) {
+            size_t i = begin;
+#ifdef PARTICLE_SSE2
+            __m128 dt = _mm_set1_ps(deltaTime);
+            for (; i + 4 <= end; i += 4) {
+                _mm_storeu_ps(pool.life + i, _mm_sub_ps(_mm_loadu_ps(pool.life + i), dt));
+                _mm_storeu_ps(pool.px + i, _mm_add_ps(_mm_loadu_ps(pool.px + i), _mm_mul_ps(_mm_loadu_ps(pool.vx + i), dt)));
+                _mm_storeu_ps(pool.py + i, _mm_add_ps(_mm_loadu_ps(pool.py + i), _mm_mul_ps(_mm_loadu_ps(pool.vy + i), dt)));
+                _mm_storeu_ps(pool.pz + i, _mm_add_ps(_mm_loadu_ps(pool.pz + i), _mm_mul_ps(_mm_loadu_ps(pool.vz + i), dt)));
+            }
+#endif
+            for (; i < end; i++) {
+                pool.life[i] -= deltaTime;
+                pool.px[i] += pool.vx[i] * deltaTime;
+                pool.py[i] += pool.vy[i] * deltaTime;
+                pool.pz[i] += pool.vz[i] * deltaTime;
+            }
+        }
+
+        void moveParticle(size_t from, size_t to) {
+            for (float* array : { pool.px, pool.py, pool.pz, pool.vx, pool.vy, pool.vz, pool.life, pool.span, pool.r, pool.g, pool.b })
+                array[to] = array[from];
+        }
+    }
+
+    bool setBackend(Backend backend, ShaderProgram& shader) {
+        if (backend == activeBackend)
+            return true;
+
+        if (backend == Backend::Gpu) {
+            ensureModel(shader);
+            if (!gpu.ready() && !gpu.init(particleModel->meshes[0]))
+                return false;
+            gpu.clear();
+        }
+        pool.count = 0;
+        activeBackend = backend;
+        return true;
+    }
+
+    Backend backend() {
+        return activeBackend;
+    }
+
+    void spawnParticles(const glm::vec3& impactPoint, int count, ShaderProgram& shader) {
+        ensureModel(shader);
+        for (int i = 0; i < count; ++i)
+            spawn(impactPoint, 2.0f, 5.0f, 1.0f, 2.0f, glm::vec3(0.0f, 0.0f, 1.0f));
+    }
+
+    int addEmitter(const Emitter& emitter, ShaderProgram& shader) {
+        ensureModel(shader);
+        emitters.push_back(EmitterState{ nextEmitterId, emitter });
+        return nextEmitterId++;
+    }
+
+    void removeEmitter(int id) {
+        emitters.erase(std::remove_if(emitters.begin(), emitters.end(), [id](const EmitterState& e) { return e.id == id; }), emitters.end());
+    }
+
+    void update(float deltaTime, ThreadPool& threadPool) {
+        for (auto& state : emitters) {
+            const Emitter& e = state.emitter;
+            state.pending += e.rate * deltaTime;
+            for (; state.pending >= 1.0f; state.pending -= 1.0f)
+                spawn(e.position, e.minSpeed, e.maxSpeed, e.minLifetime, e.maxLifetime, e.color);
+            state.elapsed += deltaTime;
+        }
+        emitters.erase(std::remove_if(emitters.begin(), emitters.end(), [](const EmitterState& s) {
+            return s.emitter.duration >= 0.0f && s.elapsed >= s.emitter.duration;
+        }), emitters.end());
+
+        if (activeBackend == Backend::Gpu) {
+            gpu.update(deltaTime);
+            return;
+        }
+
+        // a few microseconds for a full pool, only huge pools are worth splitting
+        threadPool.parallel_for(0, pool.count, 4096, [deltaTime](size_t begin, size_t end) {
+            integrate(begin, end, deltaTime);
+        });
+
+        // swap-remove, order does not matter
+        for (size_t i = 0; i < pool.count;) {
+            if (pool.life[i] > 0.0f) {
+                i++;
+                continue;
+            }
+            moveParticle(--pool.count, i);
+        }
+    }
+
+    void draw(const Frustum& frustum, size_t& visibleCount, size_t& culledCount) {
+        if (activeBackend == Backend::Gpu) {
+            gpu.draw();
+            return;
+        }
+
+        if (!particleModel || pool.count == 0)
+            return;
+
+        GLuint first;
+        ObjectBlock* dst = gObjectBuffer.allocate(static_cast<GLuint>(pool.count), first);
+        if (!dst)
+            return;
+
+        const Mesh& mesh = particleModel->meshes[0];
+        MaterialBlock material = mesh.getMaterialBlock();
+        glm::mat4 transform(1.0f);
+
+        GLsizei instances = 0;
+        for (size_t i = 0; i < pool.count; i++) {
+            glm::vec3 center(pool.px[i], pool.py[i], pool.pz[i]);
+            if (!frustum.intersects(BoundingSphere{ center, PARTICLE_RADIUS })) {
+                culledCount++;
+                continue;
+            }
+
+            // fades out over its lifetime
+            float alpha = glm::clamp(pool.life[i] / pool.span[i], 0.0f, 1.0f);
+            glm::vec4 color(pool.r[i], pool.g[i], pool.b[i], alpha);
+            transform[3] = glm::vec4(center, 1.0f);
+            material.ambient = color;
+            material.diffuse = color;
+            dst[instances++] = ObjectBlock{ transform, material };
+        }
+
+        visibleCount += instances;
+        if (instances > 0)
+            mesh.drawInstanced(first, instances);
+    }
+
+    size_t count() {
+        return pool.count;
+    }
+
+    void destroy() {
+        pool.count = 0;
+        emitters.clear();
+        gpu.destroy();
+        activeBackend = Backend::Cpu;
+
+        delete particleModel;
+        particleModel = nullptr;
+    }
+}
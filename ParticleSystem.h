@@ -1,32 +1,52 @@
 #pragma once
 
+#include <glm/glm.hpp>
 
-#include "ParticleEntity.h"
+#include "Bounds.h"
+#include "ShaderProgram.h"
+#include "ThreadPool.h"
 
+// Fixed-capacity particle pool. Particle state is kept as structure of arrays, dead particles are
+// swap-removed and everything is drawn with one instanced draw of a shared sphere.
 namespace ParticleSystem {
-    inline std::vector<ParticleEntity*> particles;
-
-    inline void spawnParticles(const glm::vec3& impactPoint, int count, ShaderProgram& shader) {
-        for (int i = 0; i < count; ++i) {
-            Model* particleModel = new Model(Assets::createSphere(0.1f, 10, 10, glm::vec4(0, 0, 1, 1), shader));
-
-            float speed = 2.0f + static_cast<float>(rand()) / RAND_MAX * 3.0f;
-            glm::vec3 randomDir(
-                (static_cast<float>(rand()) / RAND_MAX - 0.5f) * 2.0f,
-                (static_cast<float>(rand()) / RAND_MAX - 0.5f) * 2.0f,
-                (static_cast<float>(rand()) / RAND_MAX - 0.5f) * 2.0f);
-
-            if (glm::length(randomDir) < 0.001f) {
-                randomDir = glm::vec3(0.0f, 1.0f, 0.0f);
-            }
-
-            randomDir = glm::normalize(randomDir);
-            glm::vec3 particleVelocity = randomDir * speed;
-
-            float lifetime = 1.0f + static_cast<float>(rand()) / RAND_MAX;
-
-            ParticleEntity* p = new ParticleEntity(particleModel, impactPoint, particleVelocity, lifetime, glm::vec3(0.2f));
-            particles.push_back(p);
-        }
-    }
-}
\ No newline at end of file
+    // the whole pool fits into one frame region of gObjectBuffer next to the scene objects
+    constexpr size_t CAPACITY = 8192;
+    constexpr float PARTICLE_RADIUS = 0.1f;
+
+    // spawns particles continuously at rate per second
+    struct Emitter {
+        glm::vec3 position{ 0.0f };
+        float rate = 50.0f;
+        float duration = -1.0f;     // seconds, negative = until removed
+        float minSpeed = 2.0f;
+        float maxSpeed = 5.0f;
+        float minLifetime = 1.0f;
+        float maxLifetime = 2.0f;
+        glm::vec3 color{ 0.0f, 0.0f, 1.0f };
+    };
+
+    // Cpu keeps the pool above and culls per particle, Gpu runs GpuParticles with no readback.
+    // Both use the same spawn distribution and integration, so either can check the other.
+    enum class Backend { Cpu, Gpu };
+
+    // stays on Cpu when the GPU path cannot be created, live particles are dropped on a switch
+    bool setBackend(Backend backend, ShaderProgram& shader);
+    Backend backend();
+
+    // burst of count particles flying out of impactPoint, whatever does not fit is dropped
+    void spawnParticles(const glm::vec3& impactPoint, int count, ShaderProgram& shader);
+
+    // the shader is used for the shared sphere if no burst created it yet, returns an id for removeEmitter
+    int addEmitter(const Emitter& emitter, ShaderProgram& shader);
+    void removeEmitter(int id);
+
+    void update(float deltaTime, ThreadPool& pool);
+
+    // one instanced draw of every particle inside the frustum, the Gpu backend draws without culling
+    void draw(const Frustum& frustum, size_t& visibleCount, size_t& culledCount);
+
+    // live particles of the Cpu backend, the Gpu count never leaves the GPU
+    size_t count();
+
+    void destroy();
+}
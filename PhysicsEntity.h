@@ -5,14 +5,26 @@
 class PhysicsEntity {
 public:
     glm::vec3 position;
+    glm::vec3 previousPosition; // state before the last physics step, for interpolation
     glm::vec3 velocity;
     glm::vec3 acceleration;
     bool affectedByGravity;
 
-    PhysicsEntity() : position(0.0f), velocity(0.0f), acceleration(0.0f), affectedByGravity(false) {}
+    PhysicsEntity() : position(0.0f), previousPosition(0.0f), velocity(0.0f), acceleration(0.0f), affectedByGravity(false) {}
 
     virtual ~PhysicsEntity() {}
 
+    // called before every fixed step
+    void storePreviousState() {
+        previousPosition = position;
+    }
+
+    // alpha = fraction of a physics step the render time is past the last step
+    glm::vec3 getInterpolatedPosition(float alpha) const {
+        return glm::mix(previousPosition, position, alpha);
+    }
+
+    // semi-implicit Euler, deltaTime is the fixed physics step
     virtual void update(float deltaTime) {
         if (affectedByGravity) {
             acceleration.y = -9.81f;
@@ -23,4 +35,7 @@ public:
         velocity += acceleration * deltaTime;
         position += velocity * deltaTime;
     }
+
+    // serial second pass after every entity was integrated (update may run in parallel)
+    virtual void resolveCollisions(float deltaTime) {}
 };
\ No newline at end of file
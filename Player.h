@@ -5,13 +5,13 @@
 #include "PhysicsEntity.h"
 #include "Model.h"
 #include "Assets.h"
+#include "TerrainEntity.h"
 #include "Collider.h"
 #include "SphereCollider.h"
 #include "BoxCollider.h"
 #include "CollisionManager.h"
 #include "AudioPlayer.h"
 #include "ParticleSystem.h"
-#include "ParticleEntity.h"
 
 
 class Player : public PhysicsEntity {
@@ -22,12 +22,18 @@ public:
 	float movementAcceleration = 20.0f;
 	float jumpVelocity = 8.0f;
 
+	// input of the current frame, applied in every fixed step
+	glm::vec3 moveAcceleration{ 0.0f };
+	bool jumpRequested = false;
+
 	Model* playerModel;
 	Collider* collider;
+	const TerrainEntity* terrain;	// ground, flat at y = 0 when null
 
-	Player(ShaderProgram& shader, glm::vec3 startPos = glm::vec3(0, 0, 0), Model* model = nullptr) : height(2.0f), radius(0.3f), isOnGround(true), collider(nullptr) {
-		float groundY = Assets::getTerrainHeightAtPosition(startPos.x, startPos.z);
+	Player(ShaderProgram& shader, const TerrainEntity* terrain, glm::vec3 startPos = glm::vec3(0, 0, 0), Model* model = nullptr) : height(2.0f), radius(0.3f), isOnGround(true), collider(nullptr), terrain(terrain) {
+		float groundY = groundHeight(startPos.x, startPos.z);
 		position = glm::vec3(startPos.x, groundY + height / 2.0f, startPos.z);
+		previousPosition = position;
 
 
 		if (model) {
@@ -45,14 +51,29 @@ public:
 		delete collider;
 	}
 
-	glm::vec3 getHeadPosition() const {
-		return position + glm::vec3(0.0f, radius, 0.0f);
+	float groundHeight(float x, float z) const {
+		return terrain ? terrain->getHeightAt(x, z) : 0.0f;
+	}
+
+	glm::vec3 getHeadPosition(float alpha = 1.0f) const {
+		return getInterpolatedPosition(alpha) + glm::vec3(0.0f, radius, 0.0f);
 	}
 
 	virtual void update(float deltaTime) override {
+		velocity += moveAcceleration * deltaTime;
+
+		// consumed by the first step, kept while no step runs
+		if (jumpRequested && isOnGround) {
+			velocity.y = jumpVelocity;
+			isOnGround = false;
+		}
+		jumpRequested = false;
+
 		PhysicsEntity::update(deltaTime);
+	}
 
-		float terrainY = Assets::getTerrainHeightAtPosition(position.x, position.z);
+	virtual void resolveCollisions(float deltaTime) override {
+		float terrainY = groundHeight(position.x, position.z);
 		float playerBottom = position.y - radius;
 		if (playerBottom <= terrainY) {
 			position.y = terrainY + radius;
@@ -68,7 +89,8 @@ public:
 				ParticleSystem::spawnParticles(position, 15, playerModel->meshes[0].shader);
 			}
 
-			if (BoxCollider* box = dynamic_cast<BoxCollider*>(col)) {
+			if (col->shape == ColliderShape::Box) {
+				const BoxCollider* box = static_cast<const BoxCollider*>(col);
 				glm::vec3 minBound = box->center - box->halfExtents;
 				glm::vec3 maxBound = box->center + box->halfExtents;
 
@@ -93,7 +115,8 @@ public:
 						}
 					}
 				}
-			} else if (SphereCollider* sphere = dynamic_cast<SphereCollider*>(col)) {
+			} else if (col->shape == ColliderShape::Sphere) {
+				const SphereCollider* sphere = static_cast<const SphereCollider*>(col);
 				glm::vec3 diff = position - sphere->center;
 				float distance = glm::length(diff);
 
@@ -120,9 +143,9 @@ public:
 		}
 	}
 
-	void draw() {
+	void draw(float alpha = 1.0f) {
 		if (playerModel) {
-			playerModel->origin = position;
+			playerModel->origin = getInterpolatedPosition(alpha);
 			playerModel->draw();
 		}
 	}
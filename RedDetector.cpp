@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+#include "RedDetector.h"
+
+#if defined(__AVX2__)
+#define RED_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RED_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+	// cvtColor BGR2HSV tables for 8-bit images (hue range 180)
+	constexpr int HSV_SHIFT = 12;
+
+	struct HsvTables {
+		int sdiv[256];
+		int hdiv[256];
+
+		HsvTables() {
+			sdiv[0] = hdiv[0] = 0;
+			for (int i = 1; i < 256; i++) {
+				// saturate_cast<int>(double) rounds half to even, like lrint
+				sdiv[i] = static_cast<int>(std::lrint((255 << HSV_SHIFT) / (1.0 * i)));
+				hdiv[i] = static_cast<int>(std::lrint((180 << HSV_SHIFT) / (6.0 * i)));
+			}
+		}
+	};
+
+	const HsvTables& tables() {
+		static const HsvTables t;
+		return t;
+	}
+
+	bool scanScalar(const uchar* p, int count, int pixelStride) {
+		for (int i = 0; i < count; i++, p += pixelStride * 3)
+			if (RedDetector::isRed(p[0], p[1], p[2]))
+				return true;
+		return false;
+	}
+
+	// Candidate lanes are a superset of the red pixels (checked for every colour):
+	//  - r is the maximum, so OpenCV takes the "v == r" hue branch
+	//  - v >= 100
+	//  - saturation >= 100 needs diff >= 0.39 v, tested as diff >= v/4 + v/8
+	//  - hue within 10 of 0/180 needs |g - b| <= 0.351 diff, tested as |g - b| <= diff/4 + diff/8 + 2
+#if defined(RED_SSE2)
+	inline __m128i srli8(__m128i v, int shift, int mask) {
+		return _mm_and_si128(_mm_srli_epi16(v, shift), _mm_set1_epi8(static_cast<char>(mask)));
+	}
+
+	inline int candidates(const uchar* p) {
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		__m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+		__m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 2));
+
+		__m128i hi = _mm_max_epu8(g, b);
+		__m128i lo = _mm_min_epu8(g, b);
+		__m128i ok = _mm_cmpeq_epi8(_mm_max_epu8(r, hi), r);
+		ok = _mm_and_si128(ok, _mm_cmpeq_epi8(_mm_max_epu8(r, _mm_set1_epi8(100)), r));
+
+		__m128i diff = _mm_subs_epu8(r, lo);
+		__m128i satMin = _mm_add_epi8(srli8(r, 2, 0x3F), srli8(r, 3, 0x1F));
+		ok = _mm_and_si128(ok, _mm_cmpeq_epi8(_mm_max_epu8(diff, satMin), diff));
+
+		__m128i gb = _mm_sub_epi8(hi, lo);
+		__m128i hueMax = _mm_adds_epu8(_mm_add_epi8(srli8(diff, 2, 0x3F), srli8(diff, 3, 0x1F)), _mm_set1_epi8(2));
+		ok = _mm_and_si128(ok, _mm_cmpeq_epi8(_mm_min_epu8(gb, hueMax), gb));
+
+		// pixels start at lanes 0, 3, 6, 9, 12
+		return _mm_movemask_epi8(ok) & 0x1249;
+	}
+
+	constexpr int SIMD_PIXELS = 5;
+	constexpr int SIMD_BYTES = 18;	// bytes touched per block
+#elif defined(RED_AVX2)
+	inline __m256i srli8(__m256i v, int shift, int mask) {
+		return _mm256_and_si256(_mm256_srli_epi16(v, shift), _mm256_set1_epi8(static_cast<char>(mask)));
+	}
+
+	inline unsigned candidates(const uchar* p) {
+		__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		__m256i g = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+		__m256i r = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 2));
+
+		__m256i hi = _mm256_max_epu8(g, b);
+		__m256i lo = _mm256_min_epu8(g, b);
+		__m256i ok = _mm256_cmpeq_epi8(_mm256_max_epu8(r, hi), r);
+		ok = _mm256_and_si256(ok, _mm256_cmpeq_epi8(_mm256_max_epu8(r, _mm256_set1_epi8(100)), r));
+
+		__m256i diff = _mm256_subs_epu8(r, lo);
+		__m256i satMin = _mm256_add_epi8(srli8(r, 2, 0x3F), srli8(r, 3, 0x1F));
+		ok = _mm256_and_si256(ok, _mm256_cmpeq_epi8(_mm256_max_epu8(diff, satMin), diff));
+
+		__m256i gb = _mm256_sub_epi8(hi, lo);
+		__m256i hueMax = _mm256_adds_epu8(_mm256_add_epi8(srli8(diff, 2, 0x3F), srli8(diff, 3, 0x1F)), _mm256_set1_epi8(2));
+		ok = _mm256_and_si256(ok, _mm256_cmpeq_epi8(_mm256_min_epu8(gb, hueMax), gb));
+
+		// pixels start at lanes 0, 3, ..., 27
+		return static_cast<unsigned>(_mm256_movemask_epi8(ok)) & 0x09249249u;
+	}
+
+	constexpr int SIMD_PIXELS = 10;
+	constexpr int SIMD_BYTES = 34;
+#endif
+
+	bool scanRow(const uchar* row, int width) {
+		int x = 0;
+#if defined(RED_SSE2) || defined(RED_AVX2)
+		for (; x * 3 + SIMD_BYTES <= width * 3; x += SIMD_PIXELS) {
+			const uchar* p = row + x * 3;
+			auto mask = candidates(p);
+			while (mask) {
+				int lane = 0;
+				while (!(mask & (1u << lane)))
+					lane++;
+				mask &= ~(1u << lane);
+				if (RedDetector::isRed(p[lane], p[lane + 1], p[lane + 2]))
+					return true;
+			}
+		}
+#endif
+		return scanScalar(row + x * 3, width - x, 1);
+	}
+}
+
+bool RedDetector::isRed(uchar b, uchar g, uchar r) {
+	const HsvTables& t = tables();
+
+	// same integer arithmetic as cvtColor(COLOR_BGR2HSV) for CV_8U
+	int v = std::max<int>(b, std::max<int>(g, r));
+	int vmin = std::min<int>(b, std::min<int>(g, r));
+	if (v < 100)
+		return false;
+
+	int diff = v - vmin;
+	int s = (diff * t.sdiv[v] + (1 << (HSV_SHIFT - 1))) >> HSV_SHIFT;
+	if (s < 100)
+		return false;
+
+	int h;
+	if (v == r)
+		h = g - b;
+	else if (v == g)
+		h = b - r + 2 * diff;
+	else
+		h = r - g + 4 * diff;
+	h = (h * t.hdiv[diff] + (1 << (HSV_SHIFT - 1))) >> HSV_SHIFT;
+	if (h < 0)
+		h += 180;
+
+	return h <= 10 || h >= 170;
+}
+
+bool RedDetector::detect(const cv::Mat& bgr) const {
+	if (bgr.empty())
+		return false;
+	if (bgr.type() != CV_8UC3)
+		throw std::runtime_error("RedDetector: expected a CV_8UC3 image");
+
+	cv::Mat view = roi.empty() ? bgr : bgr(roi & cv::Rect(0, 0, bgr.cols, bgr.rows));
+	if (view.empty())
+		return false;
+
+	std::atomic<bool> found{ false };
+	int rowStep = std::max(step, 1);
+	int rows = (view.rows + rowStep - 1) / rowStep;
+
+	if (!pool) {
+		return scanRows(view, 0, rows, found);
+	}
+
+	// a few stripes per thread so an early hit does not wait for one long stripe
+	size_t stripes = (pool->size() + 1) * 4;
+	size_t grain = std::max<size_t>(8, (rows + stripes - 1) / stripes);
+	pool->parallel_for(0, rows, grain, [&](size_t begin, size_t end) {
+		if (!found.load(std::memory_order_relaxed) && scanRows(view, static_cast<int>(begin), static_cast<int>(end), found))
+			found.store(true, std::memory_order_relaxed);
+	});
+	return found.load();
+}
+
+bool RedDetector::scanRows(const cv::Mat& img, int rowBegin, int rowEnd, const std::atomic<bool>& found) const {
+	int stride = std::max(step, 1);
+	for (int i = rowBegin; i < rowEnd; i++) {
+		if (found.load(std::memory_order_relaxed))
+			return false;
+
+		const uchar* row = img.ptr<uchar>(i * stride);
+		bool hit = stride == 1 ? scanRow(row, img.cols) : scanScalar(row, (img.cols + stride - 1) / stride, stride);
+		if (hit)
+			return true;
+	}
+	return false;
+}
+
+bool RedDetector::verifyAgainstOpenCV() {
+	// every 24-bit colour exactly once
+	cv::Mat all(4096, 4096, CV_8UC3);
+	for (int y = 0; y < all.rows; y++) {
+		uchar* p = all.ptr<uchar>(y);
+		for (int x = 0; x < all.cols; x++) {
+			int colour = y * all.cols + x;
+			p[x * 3 + 0] = static_cast<uchar>(colour);
+			p[x * 3 + 1] = static_cast<uchar>(colour >> 8);
+			p[x * 3 + 2] = static_cast<uchar>(colour >> 16);
+		}
+	}
+
+	cv::Mat hsv, mask1, mask2, redMask;
+	cv::cvtColor(all, hsv, cv::COLOR_BGR2HSV);
+	cv::inRange(hsv, cv::Scalar(0, 100, 100), cv::Scalar(10, 255, 255), mask1);
+	cv::inRange(hsv, cv::Scalar(170, 100, 100), cv::Scalar(180, 255, 255), mask2);
+	cv::bitwise_or(mask1, mask2, redMask);
+
+	size_t mismatches = 0;
+	for (int y = 0; y < all.rows; y++) {
+		const uchar* p = all.ptr<uchar>(y);
+		const uchar* m = redMask.ptr<uchar>(y);
+		for (int x = 0; x < all.cols; x++)
+			if ((m[x] != 0) != isRed(p[x * 3], p[x * 3 + 1], p[x * 3 + 2]))
+				mismatches++;
+	}
+
+	// the SIMD prefilter must not reject a red colour in any lane
+	RedDetector detector;
+	cv::Mat probe(1, 16, CV_8UC3);
+	for (int colour = 0; colour < (1 << 24); colour++) {
+		uchar b = static_cast<uchar>(colour), g = static_cast<uchar>(colour >> 8), r = static_cast<uchar>(colour >> 16);
+		if (!isRed(b, g, r))
+			continue;
+
+		probe.setTo(cv::Scalar(0, 0, 0));
+		uchar* p = probe.ptr<uchar>(0) + (colour % 10) * 3;
+		p[0] = b;
+		p[1] = g;
+		p[2] = r;
+		if (!detector.detect(probe))
+			mismatches++;
+	}
+
+	if (mismatches)
+		std::cerr << "RedDetector: " << mismatches << " mismatches against cvtColor + inRange\n";
+	return mismatches == 0;
+}
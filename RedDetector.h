@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+
+#include <opencv2\opencv.hpp>
+
+#include "ThreadPool.h"
+
+// Answers "is there any red pixel" for a BGR image in one pass, without building HSV images or masks.
+// Red means the same as cvtColor(COLOR_BGR2HSV) + inRange(H 0-10 or 170-180, S >= 100, V >= 100),
+// bit for bit: a SIMD prefilter rejects pixels that cannot be red and the few candidates are
+// checked with OpenCV's integer HSV formula. Row stripes run in parallel and stop at the first hit.
+class RedDetector {
+public:
+	// pool == nullptr scans on the calling thread
+	explicit RedDetector(ThreadPool* pool = nullptr) : pool(pool) {}
+
+	// only every step-th row and column is looked at, 1 = every pixel
+	int step = 1;
+	// part of the image to scan, empty = all of it
+	cv::Rect roi;
+
+	// bgr must be CV_8UC3
+	bool detect(const cv::Mat& bgr) const;
+
+	// exact per-pixel test
+	static bool isRed(uchar b, uchar g, uchar r);
+
+	// compares isRed with the OpenCV path for all 2^24 colours, reports mismatches to std::cerr
+	static bool verifyAgainstOpenCV();
+
+private:
+	ThreadPool* pool;
+
+	bool scanRows(const cv::Mat& img, int rowBegin, int rowEnd, const std::atomic<bool>& found) const;
+};
@@ -0,0 +1,30 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// std140, binding = 1, updated once per frame
+struct alignas(16) FrameBlock {
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::vec3 viewPos;
+	float ambientOcclusion;
+};
+
+// std430, nested in ObjectBlock
+struct alignas(16) MaterialBlock {
+	glm::vec4 ambient;
+	glm::vec4 diffuse;
+	glm::vec4 specular;
+	float shininess;
+	int hasTexture;
+	float padding[2];
+};
+
+// std430, binding = 2, one entry per draw (indexed by gl_BaseInstance + gl_InstanceID)
+struct alignas(16) ObjectBlock {
+	glm::mat4 model;
+	MaterialBlock material;
+};
+
+static_assert(sizeof(FrameBlock) == 144, "FrameBlock does not match std140 layout");
+static_assert(sizeof(MaterialBlock) == 64, "MaterialBlock does not match std430 layout");
+static_assert(sizeof(ObjectBlock) == 128, "ObjectBlock does not match std430 layout");
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+// Bounded lock-free multi-producer multi-consumer ring buffer (Vyukov). Each cell carries a
+// sequence number that hands it over between producers and consumers, so elements are
+// stored by value and no operation allocates. Capacity is rounded up to a power of two.
+template <typename T>
+class MPMCRingBuffer {
+public:
+	static constexpr bool MULTI_PRODUCER = true;
+	static constexpr bool MULTI_CONSUMER = true;
+
+	explicit MPMCRingBuffer(size_t capacity) {
+		size_t size = 2;
+		while (size < capacity)
+			size <<= 1;
+
+		mask = size - 1;
+		buffer.reset(new Cell[size]);
+		for (size_t i = 0; i < size; i++)
+			buffer[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	MPMCRingBuffer(const MPMCRingBuffer&) = delete;
+	MPMCRingBuffer& operator=(const MPMCRingBuffer&) = delete;
+
+	// false when full, the item is left untouched then
+	bool try_push(T&& item) {
+		Cell* cell;
+		size_t pos = enqueuePos.load(std::memory_order_relaxed);
+		for (;;) {
+			cell = &buffer[pos & mask];
+			size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+			if (diff == 0) {
+				if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0) {
+				return false;
+			}
+			else {
+				pos = enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		cell->data = std::move(item);
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	// false when empty
+	bool try_pop(T& item) {
+		Cell* cell;
+		size_t pos = dequeuePos.load(std::memory_order_relaxed);
+		for (;;) {
+			cell = &buffer[pos & mask];
+			size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+			if (diff == 0) {
+				if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0) {
+				return false;
+			}
+			else {
+				pos = dequeuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		item = std::move(cell->data);
+		cell->data = T();
+		cell->sequence.store(pos + mask + 1, std::memory_order_release);
+		return true;
+	}
+
+	size_t capacity() const { return mask + 1; }
+
+	// approximate while other threads push or pop
+	size_t size() const {
+		size_t tail = enqueuePos.load(std::memory_order_relaxed);
+		size_t head = dequeuePos.load(std::memory_order_relaxed);
+		return tail > head ? tail - head : 0;
+	}
+
+private:
+	struct Cell {
+		std::atomic<size_t> sequence;
+		T data;
+	};
+
+	std::unique_ptr<Cell[]> buffer;
+	size_t mask = 0;
+
+	// producers and consumers on separate cache lines
+	alignas(64) std::atomic<size_t> enqueuePos{ 0 };
+	alignas(64) std::atomic<size_t> dequeuePos{ 0 };
+};
+
+// Bounded lock-free ring buffer for exactly one producer thread and one consumer thread.
+// Cheaper than MPMCRingBuffer: no CAS, only one acquire/release pair per operation.
+template <typename T>
+class SPSCRingBuffer {
+public:
+	static constexpr bool MULTI_PRODUCER = false;
+	static constexpr bool MULTI_CONSUMER = false;
+
+	explicit SPSCRingBuffer(size_t capacity) {
+		size_t size = 2;
+		while (size < capacity)
+			size <<= 1;
+
+		mask = size - 1;
+		buffer.reset(new T[size]);
+	}
+
+	SPSCRingBuffer(const SPSCRingBuffer&) = delete;
+	SPSCRingBuffer& operator=(const SPSCRingBuffer&) = delete;
+
+	// producer thread only, false when full
+	bool try_push(T&& item) {
+		size_t tail = tailPos.load(std::memory_order_relaxed);
+		if (tail - headPos.load(std::memory_order_acquire) > mask)
+			return false;
+
+		buffer[tail & mask] = std::move(item);
+		tailPos.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer thread only, false when empty
+	bool try_pop(T& item) {
+		size_t head = headPos.load(std::memory_order_relaxed);
+		if (head == tailPos.load(std::memory_order_acquire))
+			return false;
+
+		item = std::move(buffer[head & mask]);
+		buffer[head & mask] = T();
+		headPos.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	size_t capacity() const { return mask + 1; }
+
+	size_t size() const {
+		size_t tail = tailPos.load(std::memory_order_relaxed);
+		size_t head = headPos.load(std::memory_order_relaxed);
+		return tail > head ? tail - head : 0;
+	}
+
+private:
+	std::unique_ptr<T[]> buffer;
+	size_t mask = 0;
+
+	alignas(64) std::atomic<size_t> tailPos{ 0 };
+	alignas(64) std::atomic<size_t> headPos{ 0 };
+};
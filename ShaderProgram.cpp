@@ -11,68 +11,113 @@ ShaderProgram::ShaderProgram(const std::filesystem::path& VS_file, const std::fi
 	shader_ids.push_back(compile_shader(FS_file, GL_FRAGMENT_SHADER));
 
 	ID = link_shader(shader_ids);
+	collectUniforms();
 
-	GLint modelLoc = glGetUniformLocation(ID, "model");
-	GLint viewLoc = glGetUniformLocation(ID, "view");
-	GLint projLoc = glGetUniformLocation(ID, "projection");
+	std::cout << "Uniform locations - Model: " << getUniformLocation("model")
+		<< ", View: " << getUniformLocation("view")
+		<< ", Projection: " << getUniformLocation("projection") << std::endl;
+}
+
+ShaderProgram::ShaderProgram(const std::filesystem::path& CS_file) {
+	std::vector<GLuint> shader_ids;
+	shader_ids.push_back(compile_shader(CS_file, GL_COMPUTE_SHADER));
 
-	std::cout << "Uniform locations - Model: " << modelLoc
-		<< ", View: " << viewLoc
-		<< ", Projection: " << projLoc << std::endl;
+	ID = link_shader(shader_ids);
+	collectUniforms();
 }
 
-void ShaderProgram::setUniform(const std::string& name, const float val) {
-	auto loc = glGetUniformLocation(ID, name.c_str());
-	if (loc == -1) {
-		std::cerr << "no uniform with name:" << name << '\n';
-		return;
+void ShaderProgram::collectUniforms(void) {
+	uniform_locations.clear();
+
+	GLint count = 0;
+	GLint max_name_length = 0;
+	glGetProgramInterfaceiv(ID, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+	glGetProgramInterfaceiv(ID, GL_UNIFORM, GL_MAX_NAME_LENGTH, &max_name_length);
+
+	std::vector<char> name_buffer(std::max(max_name_length, 1));
+	const GLenum props[] = { GL_LOCATION, GL_ARRAY_SIZE };
+
+	for (GLint i = 0; i < count; i++) {
+		GLint values[2] = { -1, 0 };
+		glGetProgramResourceiv(ID, GL_UNIFORM, i, 2, props, 2, nullptr, values);
+		if (values[0] == -1)
+			continue; // member of a uniform block, has no location
+
+		glGetProgramResourceName(ID, GL_UNIFORM, i, static_cast<GLsizei>(name_buffer.size()), nullptr, name_buffer.data());
+		std::string name(name_buffer.data());
+		uniform_locations[name] = values[0];
+
+		// arrays are reported as "name[0]", make "name" and every element reachable too
+		const std::string array_suffix("[0]");
+		if (name.size() > array_suffix.size() && name.compare(name.size() - array_suffix.size(), array_suffix.size(), array_suffix) == 0) {
+			std::string base = name.substr(0, name.size() - array_suffix.size());
+			uniform_locations[base] = values[0];
+			for (GLint e = 1; e < values[1]; e++)
+				uniform_locations[base + '[' + std::to_string(e) + ']'] = values[0] + e;
+		}
 	}
-	glUniform1f(loc, val);
 }
 
-void ShaderProgram::setUniform(const std::string& name, const int val) {
-	auto loc = glGetUniformLocation(ID, name.c_str());
-	if (loc == -1) {
+GLint ShaderProgram::getUniformLocation(const std::string& name) const {
+	auto it = uniform_locations.find(name);
+	if (it == uniform_locations.end()) {
 		std::cerr << "No uniform with name: " << name << '\n';
-		return;
+		return -1;
 	}
-	glUniform1i(loc, val);
+	return it->second;
+}
+
+UniformHandle ShaderProgram::getUniformHandle(const std::string& name) const {
+	return UniformHandle{ getUniformLocation(name) };
+}
+
+void ShaderProgram::setUniform(const std::string& name, const float val) {
+	setUniform(getUniformHandle(name), val);
+}
+
+void ShaderProgram::setUniform(const std::string& name, const int val) {
+	setUniform(getUniformHandle(name), val);
 }
 
 void ShaderProgram::setUniform(const std::string& name, const glm::vec3 val) {
-	auto loc = glGetUniformLocation(ID, name.c_str());
-	if (loc == -1) {
-		std::cerr << "No uniform with name: " << name << '\n';
-		return;
-	}
-	glUniform3fv(loc, 1, glm::value_ptr(val));
+	setUniform(getUniformHandle(name), val);
 }
 
-void ShaderProgram::setUniform(const std::string& name, const glm::vec4 in_vec4) {
-	auto loc = glGetUniformLocation(ID, name.c_str());
-	if (loc == -1) {
-		std::cerr << "No uniform with name: " << name << '\n';
-		return;
-	}
-	glUniform4fv(loc, 1, glm::value_ptr(in_vec4));
+void ShaderProgram::setUniform(const std::string& name, const glm::vec4 val) {
+	setUniform(getUniformHandle(name), val);
 }
 
 void ShaderProgram::setUniform(const std::string& name, const glm::mat3 val) {
-	auto loc = glGetUniformLocation(ID, name.c_str());
-	if (loc == -1) {
-		std::cerr << "No uniform with name: " << name << '\n';
-		return;
-	}
-	glUniformMatrix3fv(loc, 1, GL_FALSE, glm::value_ptr(val));
+	setUniform(getUniformHandle(name), val);
 }
 
 void ShaderProgram::setUniform(const std::string& name, const glm::mat4 val) {
-	auto loc = glGetUniformLocation(ID, name.c_str());
-	if (loc == -1) {
-		std::cerr << "No uniform with name: " << name << '\n';
-		return;
-	}
-	glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(val));
+	setUniform(getUniformHandle(name), val);
+}
+
+// location -1 is silently ignored by glUniform*, no need to check the handle here
+void ShaderProgram::setUniform(const UniformHandle handle, const float val) {
+	glUniform1f(handle.location, val);
+}
+
+void ShaderProgram::setUniform(const UniformHandle handle, const int val) {
+	glUniform1i(handle.location, val);
+}
+
+void ShaderProgram::setUniform(const UniformHandle handle, const glm::vec3 val) {
+	glUniform3fv(handle.location, 1, glm::value_ptr(val));
+}
+
+void ShaderProgram::setUniform(const UniformHandle handle, const glm::vec4 val) {
+	glUniform4fv(handle.location, 1, glm::value_ptr(val));
+}
+
+void ShaderProgram::setUniform(const UniformHandle handle, const glm::mat3 val) {
+	glUniformMatrix3fv(handle.location, 1, GL_FALSE, glm::value_ptr(val));
+}
+
+void ShaderProgram::setUniform(const UniformHandle handle, const glm::mat4 val) {
+	glUniformMatrix4fv(handle.location, 1, GL_FALSE, glm::value_ptr(val));
 }
 
 std::string ShaderProgram::getShaderInfoLog(const GLuint shader) {
@@ -5,17 +5,26 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <unordered_map>
 
 #include <GL/glew.h> 
 
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
 
+// pre-resolved uniform location, see ShaderProgram::getUniformHandle()
+struct UniformHandle {
+	GLint location { -1 };
+
+	bool valid(void) const { return location != -1; }
+};
+
 class ShaderProgram {
 public:
 
 	ShaderProgram(void) = default; //does nothing
 	ShaderProgram(const std::filesystem::path& VS_file, const std::filesystem::path& FS_file); // TODO: load, compile, and link shader
+	explicit ShaderProgram(const std::filesystem::path& CS_file); // compute shader
 
 	void activate(void) { 
 		if (ID == currently_used)
@@ -34,6 +43,7 @@ public:
 		deactivate();
 		glDeleteProgram(ID);
 		ID = 0;
+		uniform_locations.clear();
 	}
 
 	// set uniform according to name 
@@ -45,10 +55,23 @@ public:
 	void setUniform(const std::string& name, const glm::mat3 val);
 	void setUniform(const std::string& name, const glm::mat4 val); 
 
+	// resolve uniform once, then set it by handle without any string lookup
+	UniformHandle getUniformHandle(const std::string& name) const;
+	void setUniform(const UniformHandle handle, const float val);
+	void setUniform(const UniformHandle handle, const int val);
+	void setUniform(const UniformHandle handle, const glm::vec3 val);
+	void setUniform(const UniformHandle handle, const glm::vec4 val);
+	void setUniform(const UniformHandle handle, const glm::mat3 val);
+	void setUniform(const UniformHandle handle, const glm::mat4 val);
+
 private:
 	inline static GLuint currently_used { 0 };
 
 	GLuint ID { 0 }; // default = 0, empty shader
+	std::unordered_map<std::string, GLint> uniform_locations; // filled once after linking
+
+	void collectUniforms(void);
+	GLint getUniformLocation(const std::string& name) const;
 	std::string getShaderInfoLog(const GLuint obj);   // TODO: check for shader compilation error; if any, print compiler output  
 	std::string getProgramInfoLog(const GLuint obj);  // TODO: check for linker error; if any, print linker output
 
@@ -1,22 +1,37 @@
 #include "SphereCollider.h"
-#include "BoxCollider.h"
-
-bool SphereCollider::intersects(const Collider& other) const {
-	const SphereCollider* sphere = dynamic_cast<const SphereCollider*>(&other);
-	if (sphere) {
-		float distance = glm::length(center - sphere->center);
-		return distance < (radius + sphere->radius);
-	}
-	const BoxCollider* box = dynamic_cast<const BoxCollider*>(&other);
-	if (box) {
-		glm::vec3 closestPoint = glm::clamp(center, box->center - box->halfExtents, box->center + box->halfExtents);
-		float distSq = glm::length2(center - closestPoint);
-		return distSq < (radius * radius);
-	}
-	return false;
-}
+#include "CollisionManager.h"
 
 void SphereCollider::update(const glm::vec3& position, const glm::vec3& scale) {
 	center = position;
 	radius = scale.x;
+	gCollisionManager.updateCollider(this);
+}
+
+AABB SphereCollider::getBounds() const {
+	AABB box;
+	box.min = center - glm::vec3(radius);
+	box.max = center + glm::vec3(radius);
+	return box;
+}
+
+bool SphereCollider::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const {
+	glm::vec3 m = origin - center;
+	float b = glm::dot(m, direction);
+	float c = glm::dot(m, m) - radius * radius;
+
+	// origin outside and pointing away
+	if (c > 0.0f && b > 0.0f)
+		return false;
+
+	float discriminant = b * b - c;
+	if (discriminant < 0.0f)
+		return false;
+
+	// starting inside the sphere counts as a hit at 0
+	float t = std::max(-b - std::sqrt(discriminant), 0.0f);
+	if (t > maxDistance)
+		return false;
+
+	distance = t;
+	return true;
 }
@@ -13,9 +13,11 @@ public:
 	glm::vec3 center;
 	float radius;
 
-	SphereCollider(const glm::vec3& center, float radius) : center(center), radius(radius) {}
-
-	virtual bool intersects(const Collider& other) const override;
+	SphereCollider(const glm::vec3& center, float radius) : Collider(ColliderShape::Sphere), center(center), radius(radius) {}
 
 	virtual void update(const glm::vec3& position, const glm::vec3& scale) override;
+
+	virtual AABB getBounds() const override;
+
+	virtual bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const override;
 };
\ No newline at end of file
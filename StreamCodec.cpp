@@ -0,0 +1,82 @@
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include "StreamCodec.h"
+
+void JpegCodec::encode(const cv::Mat& img, std::vector<uchar>& out) {
+	if (targetPsnr > 0.0) {
+		try {
+			encoder.encodeLimitQuality(img, targetPsnr, out);
+		} catch (const std::runtime_error&) {
+			// not even quality 100 reaches the target, send the best there is
+			cv::imencode(".jpg", img, out, bestQuality);
+		}
+	} else
+		encoder.encodeLimitBW(img, static_cast<size_t>(img.total() * img.elemSize() * sizeRatio), out);
+}
+
+bool JpegCodec::decode(const uchar* data, size_t size, cv::Mat& out) {
+	// imdecode asserts on empty input
+	if (size == 0)
+		return false;
+
+	// wraps the bytes, no copy. out is a reused frame, on unknown data imdecode leaves it untouched
+	// and returns an empty Mat
+	cv::Mat buffer(1, static_cast<int>(size), CV_8U, const_cast<uchar*>(data));
+	return !cv::imdecode(buffer, cv::IMREAD_COLOR, &out).empty();
+}
+
+void PngCodec::encode(const cv::Mat& img, std::vector<uchar>& out) {
+	cv::imencode(".png", img, out, params);
+}
+
+bool PngCodec::decode(const uchar* data, size_t size, cv::Mat& out) {
+	if (size == 0)
+		return false;
+
+	cv::Mat buffer(1, static_cast<int>(size), CV_8U, const_cast<uchar*>(data));
+	return !cv::imdecode(buffer, cv::IMREAD_UNCHANGED, &out).empty();
+}
+
+namespace {
+	struct RawHeader {
+		int32_t rows;
+		int32_t cols;
+		int32_t type;
+	};
+}
+
+void RawCodec::encode(const cv::Mat& img, std::vector<uchar>& out) {
+	RawHeader header{ img.rows, img.cols, img.type() };
+	size_t rowBytes = img.cols * img.elemSize();
+
+	out.resize(sizeof(header) + rowBytes * img.rows);
+	std::memcpy(out.data(), &header, sizeof(header));
+	for (int y = 0; y < img.rows; y++)
+		std::memcpy(out.data() + sizeof(header) + rowBytes * y, img.ptr(y), rowBytes);
+}
+
+bool RawCodec::decode(const uchar* data, size_t size, cv::Mat& out) {
+	if (size < sizeof(RawHeader))
+		return false;
+
+	RawHeader header;
+	std::memcpy(&header, data, sizeof(header));
+	// everything is checked before create(), a corrupt header must not throw or allocate
+	if (header.rows <= 0 || header.cols <= 0
+		|| (header.type != CV_8UC1 && header.type != CV_8UC3 && header.type != CV_8UC4))
+		return false;
+
+	size_t rowBytes = static_cast<size_t>(header.cols) * CV_ELEM_SIZE(header.type);
+	size_t payload = size - sizeof(header);
+	if (payload % rowBytes != 0 || payload / rowBytes != static_cast<size_t>(header.rows))
+		return false;
+
+	// allocates only when the format changes
+	out.create(header.rows, header.cols, header.type);
+
+	for (int y = 0; y < out.rows; y++)
+		std::memcpy(out.ptr(y), data + sizeof(header) + rowBytes * y, rowBytes);
+	return true;
+}
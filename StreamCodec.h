@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+
+#include <opencv2\opencv.hpp>
+
+#include "JpegEncoder.h"
+
+// Turns frames into bytes for the streaming pipeline and back. Output buffers are reused
+// between calls, one codec instance per encode/decode thread pair.
+class FrameCodec {
+public:
+	virtual ~FrameCodec() = default;
+
+	virtual const char* name() const = 0;
+	virtual void encode(const cv::Mat& img, std::vector<uchar>& out) = 0;
+	// false on corrupt input
+	virtual bool decode(const uchar* data, size_t size, cv::Mat& out) = 0;
+};
+
+// lossy, size limited to a fraction of the raw frame, or the lowest quality reaching targetPsnr
+class JpegCodec : public FrameCodec {
+public:
+	explicit JpegCodec(JpegEncoder& encoder, double sizeRatio = 0.5) : encoder(encoder), sizeRatio(sizeRatio) {}
+
+	// > 0 selects the quality by PSNR instead of size
+	double targetPsnr = 0.0;
+
+	const char* name() const override { return "JPEG"; }
+	void encode(const cv::Mat& img, std::vector<uchar>& out) override;
+	bool decode(const uchar* data, size_t size, cv::Mat& out) override;
+
+private:
+	JpegEncoder& encoder;
+	double sizeRatio;
+	std::vector<int> bestQuality{ cv::IMWRITE_JPEG_QUALITY, 100 };
+};
+
+// lossless, fastest zlib level
+class PngCodec : public FrameCodec {
+public:
+	const char* name() const override { return "PNG"; }
+	void encode(const cv::Mat& img, std::vector<uchar>& out) override;
+	bool decode(const uchar* data, size_t size, cv::Mat& out) override;
+
+private:
+	std::vector<int> params{ cv::IMWRITE_PNG_COMPRESSION, 1 };
+};
+
+// lossless, no compression: rows, cols and type followed by the pixels
+class RawCodec : public FrameCodec {
+public:
+	const char* name() const override { return "raw"; }
+	void encode(const cv::Mat& img, std::vector<uchar>& out) override;
+	bool decode(const uchar* data, size_t size, cv::Mat& out) override;
+};
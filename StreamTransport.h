@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "BoundedQueue.h"
+#include "FramePool.h"
+
+// one encoded frame on its way from the encoder to the decoder
+struct StreamPacket {
+	uint64_t frameId = 0;
+	StreamClock::time_point captured{};
+	StreamClock::time_point encoded{};
+	StreamClock::time_point received{};	// set by the transport
+	std::vector<uchar> payload;
+};
+
+// Carries packets between the encode and decode threads. A socket or shared memory transport
+// implements the same interface and serialises the header fields next to the payload.
+class FrameTransport {
+public:
+	virtual ~FrameTransport() = default;
+
+	// false once closed
+	virtual bool send(StreamPacket&& packet) = 0;
+	// false on timeout, or once closed and drained
+	virtual bool receive(StreamPacket& packet, std::chrono::milliseconds timeout) = 0;
+	virtual void close() = 0;
+};
+
+// In-process loopback, packets are moved and never copied. When the receiver falls behind the
+// oldest packets are dropped, a late frame is worth less than a fresh one.
+class LoopbackTransport : public FrameTransport {
+public:
+	explicit LoopbackTransport(size_t capacity = 4) : queue(capacity, OverflowPolicy::DropOldest) {}
+
+	bool send(StreamPacket&& packet) override {
+		if (closed.load())
+			return false;
+		return queue.push(std::move(packet));
+	}
+
+	bool receive(StreamPacket& packet, std::chrono::milliseconds timeout) override {
+		if (!queue.pop(packet, timeout))
+			return false;
+		packet.received = StreamClock::now();
+		return true;
+	}
+
+	void close() override {
+		closed.store(true);
+		queue.stop();
+	}
+
+	// packets thrown away because the receiver was too slow
+	size_t dropped() const { return queue.dropped(); }
+
+private:
+	BoundedQueue<StreamPacket> queue;
+	std::atomic<bool> closed{ false };
+};
@@ -1,9 +1,13 @@
 #pragma once
 
+#include <memory>
+
 #include <glm/glm.hpp>
 
 #include "Entity.h"
 #include "Assets.h"
+#include "Heightfield.h"
+#include "TerrainQuadtree.h"
 
 class TerrainEntity : public Entity {
 public:
@@ -11,13 +15,57 @@ public:
     float heightScale;
     float frequency;
 
-    TerrainEntity(int gridSize, float heightScale, float frequency, ShaderProgram& shader)
-        : gridSize(gridSize), heightScale(heightScale), frequency(frequency) {
-		model = new Model(Assets::createTerrain(gridSize, heightScale, frequency, shader));
+    // gridSize x gridSize units, the heightfield and the chunks are built on pool when given
+    TerrainEntity(int gridSize, float heightScale, float frequency, ShaderProgram& shader, ThreadPool* pool = nullptr)
+        : gridSize(gridSize), heightScale(heightScale), frequency(frequency),
+          heightfield(generateHeightfield(gridSize, heightScale, frequency, pool)),
+          chunks(static_cast<float>(gridSize), heightfield->spacing(), heightfield->minHeight(), heightfield->maxHeight(),
+              [heightfield = heightfield](float x, float z) { return heightfield->sample(x, z); }, shader, pool) {
+		model = nullptr;
 		collider = nullptr;
     }
 
+    // exact height of the finest chunk level, a lookup and a barycentric blend inside the chunk triangle
     float getHeightAt(float x, float z) const {
-		return Assets::getTerrainHeightAtPosition(x, z);
+		return heightfield->sample(x, z);
+    }
+
+    void sampleHeights(const glm::vec2* points, size_t count, float* heights) const {
+        heightfield->sampleHeights(points, count, heights);
+    }
+
+    glm::vec3 getNormalAt(float x, float z) const {
+        return heightfield->normal(x, z);
+    }
+
+    // picks the chunks for this frame, before the entity is submitted
+    void updateLod(const glm::vec3& cameraPosition, const Frustum& frustum, float projectionScale) {
+        chunks.update(cameraPosition, frustum, projectionScale);
+    }
+
+    AABB getWorldBounds() const override {
+        return chunks.bounds();
     }
-};
\ No newline at end of file
+
+    void submit(InstanceBatch& batch) override {
+        chunks.submit(batch);
+    }
+
+    void draw() override {
+        chunks.draw();
+    }
+
+    size_t drawnChunks() const { return chunks.selectedChunks(); }
+    size_t loadedChunks() const { return chunks.loadedChunks(); }
+
+private:
+    static std::shared_ptr<const Heightfield> generateHeightfield(int gridSize, float heightScale, float frequency, ThreadPool* pool) {
+        // one sample per unit, the noise is evaluated only here
+        Assets::setTerrainParameters(gridSize, heightScale, frequency);
+        return std::make_shared<const Heightfield>(gridSize, 1.0f, &Assets::getTerrainHeightAtPosition, pool);
+    }
+
+    // shared with chunk builds still running on the pool
+    std::shared_ptr<const Heightfield> heightfield;
+    TerrainQuadtree chunks;
+};
@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <cmath>
+
+#include "TerrainQuadtree.h"
+
+TerrainQuadtree::TerrainQuadtree(float worldSize, float leafSpacing, float minHeight, float maxHeight, HeightFunction height, ShaderProgram& shader, ThreadPool* pool)
+    : worldSize(worldSize), minHeight(minHeight), maxHeight(maxHeight), height(std::move(height)), shader(shader), pool(pool) {
+    float rootSpacing = worldSize / CHUNK_QUADS;
+    maxLevel = std::max(0, static_cast<int>(std::ceil(std::log2(rootSpacing / leafSpacing))));
+    root = makeNode(glm::vec2(0.0f), worldSize, 0);
+}
+
+std::unique_ptr<TerrainQuadtree::Node> TerrainQuadtree::makeNode(const glm::vec2& center, float size, int level) const {
+    auto node = std::make_unique<Node>();
+    node->center = center;
+    node->size = size;
+    node->level = level;
+
+    float half = size * 0.5f;
+    float skirt = spacing(level) * 4.0f;
+    node->bounds.min = glm::vec3(center.x - half, minHeight - skirt, center.y - half);
+    node->bounds.max = glm::vec3(center.x + half, maxHeight, center.y + half);
+    return node;
+}
+
+float TerrainQuadtree::spacing(int level) const {
+    return worldSize / CHUNK_QUADS / static_cast<float>(1 << level);
+}
+
+AABB TerrainQuadtree::bounds() const {
+    return root->bounds;
+}
+
+void TerrainQuadtree::buildChunk(Build& build, const glm::vec2& center, float size, float worldSize, const HeightFunction& height) {
+    const int n = CHUNK_QUADS + 1;
+    const float step = size / CHUNK_QUADS;
+    const glm::vec2 origin = center - glm::vec2(size * 0.5f);
+
+    // heights with a one sample border, normals come from central differences and match across chunks
+    const int m = n + 2;
+    std::vector<float> heights(m * m);
+    for (int z = 0; z < m; ++z)
+        for (int x = 0; x < m; ++x)
+            heights[z * m + x] = height(origin.x + (x - 1) * step, origin.y + (z - 1) * step);
+
+    auto h = [&](int x, int z) { return heights[(z + 1) * m + (x + 1)]; };
+
+    build.vertices.resize(n * n + 4 * n);
+    build.minY = h(0, 0);
+    build.maxY = h(0, 0);
+    for (int z = 0; z < n; ++z) {
+        for (int x = 0; x < n; ++x) {
+            float worldX = origin.x + x * step;
+            float worldZ = origin.y + z * step;
+            float y = h(x, z);
+            build.minY = std::min(build.minY, y);
+            build.maxY = std::max(build.maxY, y);
+
+            Vertex& v = build.vertices[z * n + x];
+            v.position = glm::vec3(worldX, y, worldZ);
+            v.normal = glm::normalize(glm::vec3(h(x - 1, z) - h(x + 1, z), 2.0f * step, h(x, z - 1) - h(x, z + 1)));
+            v.texCoords = glm::vec2(worldX, worldZ) / worldSize + 0.5f;
+        }
+    }
+
+    build.indices.reserve(CHUNK_QUADS * CHUNK_QUADS * 6 + 4 * CHUNK_QUADS * 6);
+    for (int z = 0; z < CHUNK_QUADS; ++z) {
+        for (int x = 0; x < CHUNK_QUADS; ++x) {
+            GLuint topLeft = z * n + x;
+            GLuint topRight = topLeft + 1;
+            GLuint bottomLeft = (z + 1) * n + x;
+            GLuint bottomRight = bottomLeft + 1;
+
+            build.indices.insert(build.indices.end(), { topLeft, bottomLeft, topRight, topRight, bottomLeft, bottomRight });
+        }
+    }
+
+    // a coarser neighbour can differ by about one of its own steps, four of ours cover that
+    const float skirtDepth = step * 4.0f;
+
+    // every edge walked so that (a, b, a') faces outwards
+    GLuint skirtBase = n * n;
+    for (int edge = 0; edge < 4; ++edge) {
+        for (int i = 0; i < n; ++i) {
+            int x, z;
+            switch (edge) {
+            case 0: x = i; z = 0; break;                        // -z side, walking +x
+            case 1: x = n - 1; z = i; break;                    // +x side, walking +z
+            case 2: x = n - 1 - i; z = n - 1; break;            // +z side, walking -x
+            default: x = 0; z = n - 1 - i; break;               // -x side, walking -z
+            }
+
+            GLuint top = z * n + x;
+            GLuint bottom = skirtBase + i;
+            build.vertices[bottom] = build.vertices[top];
+            build.vertices[bottom].position.y -= skirtDepth;
+
+            if (i > 0) {
+                GLuint prevTop = top;
+                switch (edge) {
+                case 0: prevTop = top - 1; break;
+                case 1: prevTop = top - n; break;
+                case 2: prevTop = top + 1; break;
+                default: prevTop = top + n; break;
+                }
+                GLuint prevBottom = bottom - 1;
+                build.indices.insert(build.indices.end(), { prevTop, top, prevBottom, top, bottom, prevBottom });
+            }
+        }
+        skirtBase += n;
+    }
+
+    build.minY -= skirtDepth;
+}
+
+bool TerrainQuadtree::load(Node& node) {
+    if (node.model)
+        return true;
+
+    if (!node.build) {
+        // without a pool (or for the very first chunk) there is nothing to wait for
+        if (!pool || !root->model) {
+            node.build = std::make_shared<Build>();
+            buildChunk(*node.build, node.center, node.size, worldSize, height);
+            node.build->done.store(true, std::memory_order_release);
+        }
+        else {
+            if (buildsInFlight >= MAX_BUILDS_IN_FLIGHT)
+                return false;
+
+            auto build = std::make_shared<Build>();
+            node.build = build;
+            buildsInFlight++;
+            // owns copies only, the node may be freed before it finishes
+            pool->submit([build, center = node.center, size = node.size, worldSize = worldSize, height = height]() {
+                buildChunk(*build, center, size, worldSize, height);
+                build->done.store(true, std::memory_order_release);
+            });
+            return false;
+        }
+    }
+    else {
+        if (!node.build->done.load(std::memory_order_acquire) || uploadsThisFrame >= MAX_UPLOADS_PER_FRAME)
+            return false;
+        buildsInFlight--;
+        uploadsThisFrame++;
+    }
+
+    Build& build = *node.build;
+    node.model = std::make_unique<Model>(GL_TRIANGLES, build.vertices, build.indices, shader);
+    node.bounds.min.y = build.minY;
+    node.bounds.max.y = build.maxY;
+    node.build.reset();
+    return true;
+}
+
+void TerrainQuadtree::select(Node& node, const glm::vec3& cameraPosition, const Frustum& frustum, float projectionScale) {
+    node.lastUsed = frame;
+    if (!frustum.intersects(node.bounds))
+        return;
+
+    if (!load(node))
+        return;
+
+    // spacing projected from the closest point of the chunk
+    glm::vec3 closest = glm::clamp(cameraPosition, node.bounds.min, node.bounds.max);
+    float distance = std::max(glm::length(cameraPosition - closest), 0.001f);
+    float pixelError = spacing(node.level) * projectionScale / distance;
+
+    if (node.level < maxLevel && pixelError > maxPixelError) {
+        float quarter = node.size * 0.25f;
+        if (!node.children[0]) {
+            for (int i = 0; i < 4; ++i) {
+                glm::vec2 offset((i & 1) ? quarter : -quarter, (i & 2) ? quarter : -quarter);
+                node.children[i] = makeNode(node.center + offset, node.size * 0.5f, node.level + 1);
+            }
+        }
+
+        // children outside the frustum do not have to be ready
+        bool ready = true;
+        for (auto& child : node.children) {
+            child->lastUsed = frame;
+            if (frustum.intersects(child->bounds) && !load(*child))
+                ready = false;
+        }
+
+        if (ready) {
+            for (auto& child : node.children)
+                select(*child, cameraPosition, frustum, projectionScale);
+            return;
+        }
+    }
+
+    selected.push_back(&node);
+}
+
+void TerrainQuadtree::prune(Node& node) {
+    if (node.model)
+        loaded++;
+    if (!node.children[0])
+        return;
+
+    // a child is never visited without its parent, so unused children have no used descendants
+    bool unused = std::all_of(node.children.begin(), node.children.end(), [this](const std::unique_ptr<Node>& child) {
+        return child->lastUsed + keepFrames < frame;
+    });
+
+    if (unused) {
+        std::vector<Node*> stack;
+        for (auto& child : node.children)
+            stack.push_back(child.get());
+        while (!stack.empty()) {
+            Node* n = stack.back();
+            stack.pop_back();
+            if (n->build)
+                buildsInFlight--;   // still running, the worker only touches its own Build
+            for (auto& child : n->children)
+                if (child)
+                    stack.push_back(child.get());
+        }
+        for (auto& child : node.children)
+            child.reset();
+        return;
+    }
+
+    for (auto& child : node.children)
+        prune(*child);
+}
+
+void TerrainQuadtree::update(const glm::vec3& cameraPosition, const Frustum& frustum, float projectionScale) {
+    frame++;
+    uploadsThisFrame = 0;
+    selected.clear();
+
+    select(*root, cameraPosition, frustum, projectionScale);
+
+    loaded = 0;
+    prune(*root);
+}
+
+void TerrainQuadtree::submit(InstanceBatch& batch) const {
+    for (const Node* node : selected)
+        node->model->submit(batch);
+}
+
+void TerrainQuadtree::draw() const {
+    for (const Node* node : selected)
+        node->model->draw();
+}
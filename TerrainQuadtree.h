@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+#include "InstanceBatch.h"
+#include "Model.h"
+#include "ShaderProgram.h"
+#include "ThreadPool.h"
+
+// Square terrain split into a quadtree of chunks with the same tessellation on every level, so
+// each level halves the vertex spacing. A chunk is refined while its spacing covers more than
+// maxPixelError pixels on screen. Chunk meshes are built on the thread pool the first time they
+// are needed and drawn once uploaded, until then the parent stays on screen. Skirts hang down
+// from every chunk edge and hide the cracks between neighbours of different levels.
+class TerrainQuadtree {
+public:
+    static constexpr int CHUNK_QUADS = 32;              // quads per chunk side on every level
+    static constexpr int MAX_UPLOADS_PER_FRAME = 4;
+    static constexpr int MAX_BUILDS_IN_FLIGHT = 16;
+
+    using HeightFunction = std::function<float(float x, float z)>;
+
+    // worldSize x worldSize centred on the origin, the finest level has at most leafSpacing between
+    // vertices, heights stay within [minHeight, maxHeight]. height is called from worker threads.
+    // With worldSize = CHUNK_QUADS * leafSpacing * 2^n the finest level lies on the leafSpacing grid.
+    TerrainQuadtree(float worldSize, float leafSpacing, float minHeight, float maxHeight, HeightFunction height, ShaderProgram& shader, ThreadPool* pool = nullptr);
+
+    TerrainQuadtree(const TerrainQuadtree&) = delete;
+    TerrainQuadtree& operator=(const TerrainQuadtree&) = delete;
+
+    // render thread, once per frame before submit(). projectionScale is the viewport height
+    // divided by 2 * tan(fovY / 2), i.e. pixels per unit at distance 1
+    void update(const glm::vec3& cameraPosition, const Frustum& frustum, float projectionScale);
+
+    // chunks selected by the last update()
+    void submit(InstanceBatch& batch) const;
+    void draw() const;
+
+    AABB bounds() const;
+    size_t selectedChunks() const { return selected.size(); }
+    size_t loadedChunks() const { return loaded; }
+
+    float maxPixelError = 2.0f;
+    int keepFrames = 120;   // chunks not visited for this many frames are freed
+
+private:
+    // written by a worker, the node reads it once done is set
+    struct Build {
+        std::vector<Vertex> vertices;
+        std::vector<GLuint> indices;
+        float minY = 0.0f;
+        float maxY = 0.0f;
+        std::atomic<bool> done{ false };
+    };
+
+    struct Node {
+        glm::vec2 center;
+        float size;
+        int level;
+        AABB bounds;        // conservative until the chunk is built
+        std::unique_ptr<Model> model;
+        std::shared_ptr<Build> build;
+        std::array<std::unique_ptr<Node>, 4> children;
+        uint64_t lastUsed = 0;
+    };
+
+    std::unique_ptr<Node> makeNode(const glm::vec2& center, float size, int level) const;
+    float spacing(int level) const;
+
+    // true when the node can be drawn, requests a build or uploads a finished one otherwise
+    bool load(Node& node);
+    void select(Node& node, const glm::vec3& cameraPosition, const Frustum& frustum, float projectionScale);
+    void prune(Node& node);
+
+    static void buildChunk(Build& build, const glm::vec2& center, float size, float worldSize, const HeightFunction& height);
+
+    float worldSize;
+    float minHeight;
+    float maxHeight;
+    int maxLevel;
+    HeightFunction height;
+    ShaderProgram& shader;
+    ThreadPool* pool;
+
+    std::unique_ptr<Node> root;
+    std::vector<const Node*> selected;
+    uint64_t frame = 0;
+    int uploadsThisFrame = 0;
+    int buildsInFlight = 0;
+    size_t loaded = 0;
+};
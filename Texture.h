@@ -0,0 +1,87 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <GL/glew.h>
+
+#include "stb_image.h"
+
+// owns a GL texture, shared between meshes through std::shared_ptr
+struct Texture {
+	GLuint id{ 0 };
+
+	explicit Texture(GLuint id) : id(id) {}
+
+	Texture(const Texture&) = delete;
+	Texture& operator=(const Texture&) = delete;
+
+	~Texture() {
+		if (id != 0) {
+			glDeleteTextures(1, &id);
+			id = 0;
+		}
+	}
+};
+
+// decoded image in CPU memory, pixels are tightly packed rows of 1-4 channels
+struct ImageData {
+	int width{ 0 };
+	int height{ 0 };
+	int channels{ 0 };
+	std::unique_ptr<unsigned char, void(*)(void*)> pixels{ nullptr, stbi_image_free };
+
+	size_t size() const { return size_t(width) * height * channels; }
+};
+
+// safe to call from worker threads, does not touch OpenGL
+inline bool decodeImage(const std::string& path, bool flipYAxis, ImageData& image) {
+	stbi_set_flip_vertically_on_load_thread(flipYAxis);
+	image.pixels.reset(stbi_load(path.c_str(), &image.width, &image.height, &image.channels, 0));
+
+	if (!image.pixels) {
+		std::cerr << "Texture failed to load at path: " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// pixels can be an offset into a bound GL_PIXEL_UNPACK_BUFFER
+inline GLuint createTexture(int width, int height, int nrChannels, const void* pixels) {
+	GLuint textureID;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+
+	GLenum format = GL_RGB;
+	if (nrChannels == 1) format = GL_RED;
+	else if (nrChannels == 3) format = GL_RGB;
+	else if (nrChannels == 4) format = GL_RGBA;
+
+	glTexImage2D(GL_TEXTURE_2D,
+		0,                 // mipmap level
+		format,           // internal format
+		width, height,
+		0,                 // border
+		format,           // format of the source image
+		GL_UNSIGNED_BYTE,
+		pixels);
+	glGenerateMipmap(GL_TEXTURE_2D);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	return textureID;
+}
+
+inline GLuint loadTextureFromFile(const std::string& path, bool flipYAxis) {
+	ImageData image;
+	if (!decodeImage(path, flipYAxis, image))
+		return 0;
+
+	return createTexture(image.width, image.height, image.channels, image.pixels.get());
+}
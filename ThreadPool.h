@@ -1,81 +1,437 @@
+#pragma once
+
 #include <vector>
 #include <thread>
-#include <queue>
+#include <deque>
 #include <functional>
 #include <mutex>
 #include <condition_variable>
 #include <future>
+#include <atomic>
+#include <algorithm>
+#include <exception>
+#include <memory>
+#include <chrono>
+#include <new>
+#include <type_traits>
+
+#include "RingBuffer.h"
+
+// Move-only type-erased callable. Callables up to INLINE_SIZE bytes (lambdas capturing a few
+// pointers, a shared_ptr or a packaged_task) are stored inline, bigger ones on the heap.
+class Task {
+public:
+    static constexpr size_t INLINE_SIZE = 48;
+
+    Task() = default;
+
+    template<class F, class = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Task>>>
+    Task(F&& f) {
+        using Fn = std::decay_t<F>;
+        if constexpr (fitsInline<Fn>()) {
+            new (storage) Fn(std::forward<F>(f));
+            ops = &inlineOps<Fn>;
+        } else {
+            *reinterpret_cast<Fn**>(storage) = new Fn(std::forward<F>(f));
+            ops = &heapOps<Fn>;
+        }
+    }
+
+    Task(Task&& other) noexcept {
+        moveFrom(other);
+    }
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() {
+        reset();
+    }
 
+    void operator()() {
+        ops->invoke(storage);
+    }
+
+    explicit operator bool() const {
+        return ops != nullptr;
+    }
+
+    void reset() {
+        if (ops) {
+            ops->destroy(storage);
+            ops = nullptr;
+        }
+    }
+
+private:
+    struct Ops {
+        void (*invoke)(void* storage);
+        void (*move)(void* from, void* to); // leaves from destroyed
+        void (*destroy)(void* storage);
+    };
+
+    template<class Fn>
+    static constexpr bool fitsInline() {
+        return sizeof(Fn) <= INLINE_SIZE && alignof(Fn) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<Fn>;
+    }
+
+    template<class Fn>
+    static constexpr Ops inlineOps = {
+        [](void* storage) { (*std::launder(reinterpret_cast<Fn*>(storage)))(); },
+        [](void* from, void* to) {
+            Fn* source = std::launder(reinterpret_cast<Fn*>(from));
+            new (to) Fn(std::move(*source));
+            source->~Fn();
+        },
+        [](void* storage) { std::launder(reinterpret_cast<Fn*>(storage))->~Fn(); },
+    };
+
+    template<class Fn>
+    static constexpr Ops heapOps = {
+        [](void* storage) { (**reinterpret_cast<Fn**>(storage))(); },
+        [](void* from, void* to) { *reinterpret_cast<Fn**>(to) = *reinterpret_cast<Fn**>(from); },
+        [](void* storage) { delete *reinterpret_cast<Fn**>(storage); },
+    };
+
+    void moveFrom(Task& other) {
+        if (other.ops) {
+            other.ops->move(other.storage, storage);
+            ops = other.ops;
+            other.ops = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char storage[INLINE_SIZE];
+    const Ops* ops = nullptr;
+};
+
+// Work-stealing pool: every worker owns a lock-free queue. Tasks submitted from a worker go to
+// its own queue, other threads spread them over the workers, idle workers steal from the others.
 class ThreadPool {
 public:
     ThreadPool(size_t);
     template<class F, class... Args>
     auto enqueue(F&& f, Args&&... args) -> std::future<typename std::invoke_result_t<F, Args...>>;
+
+    // fire-and-forget, no future, no allocation for small callables
+    template<class F>
+    void submit(F&& f);
+
+    // body(chunkBegin, chunkEnd) over [begin, end) in chunks of grain elements. The calling thread
+    // works too and returns when every chunk is done, the first exception is rethrown.
+    template<class F>
+    void parallel_for(size_t begin, size_t end, size_t grain, F&& body);
+
+    // runs one queued task on the calling thread, false when there is none
+    bool runPendingTask();
+
+    size_t size() const { return workers.size(); }
+
     ~ThreadPool();
 
 private:
+    static constexpr size_t QUEUE_CAPACITY = 1024;
+    static constexpr int SPIN_ROUNDS = 64;
+
     std::vector<std::thread> workers;
-    std::queue<std::function<void()>> tasks;
+    std::vector<std::unique_ptr<MPMCRingBuffer<Task>>> queues;
+
+    // only used when a worker queue is full
+    std::deque<Task> overflow;
+    std::mutex overflow_mutex;
 
+    std::atomic<size_t> queued{ 0 };
+    std::atomic<size_t> nextQueue{ 0 };
+
+    // sleeping workers
     std::mutex queue_mutex;
     std::condition_variable condition;
-    bool stop;
+    std::atomic<int> sleeping{ 0 };
+    std::atomic<bool> stop;
+
+    void push(Task&& task);
+    bool take(size_t self, Task& task);
+    void workerLoop(size_t index);
+
+    // index of the calling worker of this pool, or size() for other threads
+    size_t currentWorker() const;
 };
 
+namespace ThreadPoolDetail {
+    inline thread_local const ThreadPool* currentPool = nullptr;
+    inline thread_local size_t currentIndex = 0;
+}
+
 inline ThreadPool::ThreadPool(size_t threads) : stop(false) {
     for (size_t i = 0; i < threads; ++i)
-        workers.emplace_back(
-            [this] {
-                for (;;) {
-                    std::function<void()> task;
-
-                    {
-                        std::unique_lock<std::mutex> lock(this->queue_mutex);
-                        this->condition.wait(lock,
-                            [this] { return this->stop || !this->tasks.empty(); });
-                        if (this->stop && this->tasks.empty())
-                            return;
-                        task = std::move(this->tasks.front());
-                        this->tasks.pop();
-                    }
-
-                    task();
-                }
-            }
-        );
+        queues.emplace_back(std::make_unique<MPMCRingBuffer<Task>>(QUEUE_CAPACITY));
+
+    for (size_t i = 0; i < threads; ++i)
+        workers.emplace_back([this, i] { workerLoop(i); });
+}
+
+inline size_t ThreadPool::currentWorker() const {
+    return ThreadPoolDetail::currentPool == this ? ThreadPoolDetail::currentIndex : workers.size();
+}
+
+inline void ThreadPool::push(Task&& task) {
+    queued.fetch_add(1);
+
+    size_t self = currentWorker();
+    size_t target = self < queues.size() ? self : nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    if (!queues[target]->try_push(std::move(task))) {
+        std::lock_guard<std::mutex> lock(overflow_mutex);
+        overflow.push_back(std::move(task));
+    }
+
+    // pairs with the sleeping/queued check in workerLoop, seq_cst on both sides
+    if (sleeping.load() > 0) {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        condition.notify_one();
+    }
+}
+
+inline bool ThreadPool::take(size_t self, Task& task) {
+    size_t count = queues.size();
+    if (count == 0)
+        return false;
+
+    // own queue first, then steal starting at the neighbour
+    size_t start = self < count ? self : 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (queues[(start + i) % count]->try_pop(task)) {
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(overflow_mutex);
+    if (overflow.empty())
+        return false;
+    task = std::move(overflow.front());
+    overflow.pop_front();
+    queued.fetch_sub(1);
+    return true;
+}
+
+inline void ThreadPool::workerLoop(size_t index) {
+    ThreadPoolDetail::currentPool = this;
+    ThreadPoolDetail::currentIndex = index;
+
+    Task task;
+    for (;;) {
+        bool found = false;
+        for (int spin = 0; spin < SPIN_ROUNDS && !found; ++spin) {
+            found = take(index, task);
+            if (!found)
+                std::this_thread::yield();
+        }
+
+        if (found) {
+            task();
+            task.reset();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        sleeping.fetch_add(1);
+        condition.wait(lock, [this] { return stop.load() || queued.load() > 0; });
+        sleeping.fetch_sub(1);
+
+        if (stop.load() && queued.load() == 0)
+            return;
+    }
 }
 
 template<class F, class... Args>
 auto ThreadPool::enqueue(F&& f, Args&&... args) -> std::future<typename std::invoke_result_t<F, Args...>> {
     using return_type = typename std::invoke_result<F, Args...>::type;
 
-    auto task = std::make_shared<std::packaged_task<return_type()>>(
+    std::packaged_task<return_type()> task(
         [func = std::forward<F>(f), args_tuple = std::make_tuple(std::forward<Args>(args)...)]() mutable {
             return std::apply(std::move(func), std::move(args_tuple));
         }
     );
 
-    std::future<return_type> res = task->get_future();
-    {
-        std::unique_lock<std::mutex> lock(queue_mutex);
+    std::future<return_type> res = task.get_future();
 
-        if (stop)
-            throw std::runtime_error("enqueue on stopped ThreadPool");
+    if (stop.load())
+        throw std::runtime_error("enqueue on stopped ThreadPool");
 
-        tasks.emplace([task]() { (*task)(); });
-    }
-    condition.notify_one();
+    push(Task(std::move(task)));
     return res;
 }
 
+template<class F>
+void ThreadPool::submit(F&& f) {
+    if (stop.load())
+        throw std::runtime_error("submit on stopped ThreadPool");
+
+    push(Task(std::forward<F>(f)));
+}
+
+template<class F>
+void ThreadPool::parallel_for(size_t begin, size_t end, size_t grain, F&& body) {
+    if (end <= begin)
+        return;
+
+    grain = std::max<size_t>(grain, 1);
+    size_t chunks = (end - begin + grain - 1) / grain;
+    if (chunks == 1 || workers.empty()) {
+        body(begin, end);
+        return;
+    }
+
+    // one allocation per call, the helpers keep it alive even if they start after the caller returned
+    struct State {
+        std::atomic<size_t> nextChunk{ 0 };
+        std::atomic<size_t> doneChunks{ 0 };
+        size_t chunks = 0;
+        size_t begin = 0;
+        size_t end = 0;
+        size_t grain = 1;
+        std::remove_reference_t<F>* body = nullptr;
+
+        std::mutex mutex;
+        std::condition_variable done;
+        std::exception_ptr error;
+    };
+
+    auto state = std::make_shared<State>();
+    state->chunks = chunks;
+    state->begin = begin;
+    state->end = end;
+    state->grain = grain;
+    state->body = &body;
+
+    // body is only touched after claiming a chunk, and the caller waits for all chunks
+    auto work = [state]() {
+        for (;;) {
+            size_t chunk = state->nextChunk.fetch_add(1);
+            if (chunk >= state->chunks)
+                return;
+
+            size_t chunkBegin = state->begin + chunk * state->grain;
+            size_t chunkEnd = std::min(chunkBegin + state->grain, state->end);
+            try {
+                (*state->body)(chunkBegin, chunkEnd);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (!state->error)
+                    state->error = std::current_exception();
+            }
+
+            if (state->doneChunks.fetch_add(1) + 1 == state->chunks) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->done.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = std::min(workers.size(), chunks - 1);
+    if (!stop.load()) {
+        for (size_t i = 0; i < helpers; ++i)
+            push(Task(work));
+    }
+
+    work();
+
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->done.wait(lock, [&] { return state->doneChunks.load() == state->chunks; });
+    }
+
+    if (state->error)
+        std::rethrow_exception(state->error);
+}
+
+inline bool ThreadPool::runPendingTask() {
+    Task task;
+    if (!take(currentWorker(), task))
+        return false;
+    task();
+    return true;
+}
+
+// fork-join group of independent tasks, wait() runs queued tasks while it waits
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool) : pool(pool), state(std::make_shared<State>()) {}
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    ~TaskGroup() {
+        try {
+            wait();
+        } catch (...) {
+        }
+    }
+
+    template<class F>
+    void run(F&& f) {
+        state->pending.fetch_add(1);
+        pool.submit([state = state, f = std::forward<F>(f)]() mutable {
+            try {
+                f();
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (!state->error)
+                    state->error = std::current_exception();
+            }
+            if (state->pending.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->done.notify_all();
+            }
+        });
+    }
+
+    // rethrows the first exception of the group
+    void wait() {
+        while (state->pending.load() > 0) {
+            if (pool.runPendingTask())
+                continue;
+
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->done.wait_for(lock, std::chrono::milliseconds(1), [&] { return state->pending.load() == 0; });
+        }
+
+        std::exception_ptr error;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            std::swap(error, state->error);
+        }
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+private:
+    struct State {
+        std::atomic<size_t> pending{ 0 };
+        std::mutex mutex;
+        std::condition_variable done;
+        std::exception_ptr error;
+    };
+
+    ThreadPool& pool;
+    std::shared_ptr<State> state;
+};
+
 inline ThreadPool::~ThreadPool() {
+    stop.store(true);
     {
-        std::unique_lock<std::mutex> lock(queue_mutex);
-        stop = true;
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        condition.notify_all();
     }
-    condition.notify_all();
     for (std::thread& worker : workers) {
         worker.join();
     }
-		
 }
@@ -51,7 +51,7 @@ public:
 	}
 
 private:
-	bool stop_;
+	bool stop_ = false;
 	std::queue<T> queue_;
 	mutable std::mutex mutex_;
 	std::condition_variable cond_var_;
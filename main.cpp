@@ -35,6 +35,13 @@ static void init(void) {
 
 int main(int argc, char* argv[]) {
 
+	app.parseArguments(argc, argv);
+	if (app.verifyRedDetector) {
+		bool ok = RedDetector::verifyAgainstOpenCV();
+		std::cout << "RedDetector " << (ok ? "matches" : "does not match") << " cvtColor + inRange" << std::endl;
+		exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
 	app.init();
 	app.run();
 
@@ -22,6 +22,13 @@ layout(std140, binding = 0) uniform LightsBlock {
     Light lights[MAX_LIGHTS];
 };
 
+layout(std140, binding = 1) uniform FrameBlock {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;   // camera position in world
+    float ambientOcclusion;
+};
+
 struct Material {
     vec4 ambient;
     vec4 diffuse;
@@ -30,17 +37,29 @@ struct Material {
     int hasTexture;
 };
 
+struct Object {
+    mat4 model;
+    Material material;
+};
+
+layout(std430, binding = 2) readonly buffer ObjectBlock {
+    Object objects[];
+};
+
 in vec3 fragPos;
 in vec3 fragNormal;
 in vec2 fragTexCoords;
+flat in int objectIndex;
+
+layout(binding = 0) uniform sampler2D texture_diffuse1;
 
-uniform Material material;
-uniform sampler2D texture_diffuse1;
+Material material;
 
-uniform vec3 viewPos;   // camera position in world
-uniform float ambientOcclusion;
+// 0 = forward with alpha blending, 1 = weighted blended OIT accumulation (OitBuffer)
+uniform int oitPass;
 
-out vec4 FragColor;
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out float Revealage;
 
 vec4 CalcLightContribution(Light light, vec3 norm, vec3 viewDir, vec4 diffuseColor) {
     vec4 result = vec4(0.0);
@@ -83,6 +102,8 @@ vec4 CalcLightContribution(Light light, vec3 norm, vec3 viewDir, vec4 diffuseCol
 }
 
 void main() {
+    material = objects[objectIndex].material;
+
     vec4 diffuseColor = (material.hasTexture == 1) ? texture(texture_diffuse1, fragTexCoords) : material.diffuse;
     vec3 norm = normalize(fragNormal);
     vec3 viewDir = normalize(viewPos - fragPos);
@@ -92,6 +113,15 @@ void main() {
         finalColor += CalcLightContribution(lights[i], norm, viewDir, diffuseColor);
     }
 
+    if (oitPass == 1) {
+        // McGuire & Bavoil weight, nearer and more opaque layers dominate the average
+        float alpha = diffuseColor.a;
+        float weight = clamp(pow(min(1.0, alpha * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+        FragColor = vec4(finalColor.rgb * alpha, alpha) * weight;
+        Revealage = alpha;
+        return;
+    }
+
     FragColor = finalColor;
     FragColor.a = diffuseColor.a;
 }
\ No newline at end of file
@@ -3,15 +3,40 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTex;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout(std140, binding = 1) uniform FrameBlock {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    float ambientOcclusion;
+};
+
+struct Material {
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+    float shininess;
+    int hasTexture;
+};
+
+struct Object {
+    mat4 model;
+    Material material;
+};
+
+layout(std430, binding = 2) readonly buffer ObjectBlock {
+    Object objects[];
+};
 
 out vec3 fragPos;
 out vec3 fragNormal;
 out vec2 fragTexCoords;
+flat out int objectIndex;
 
 void main() {
+    // one ObjectBlock entry per draw/instance, selected by the draw's baseInstance
+    objectIndex = gl_BaseInstance + gl_InstanceID;
+    mat4 model = objects[objectIndex].model;
+
     vec4 worldPos = model * vec4(aPos, 1.0);
 	fragPos = worldPos.xyz;
 	fragNormal = mat3(transpose(inverse(model))) * aNormal;
@@ -0,0 +1,23 @@
+#version 460 core
+
+// resolves the weighted blended accumulation written by modelFS.glsl with oitPass = 1
+
+layout(binding = 0) uniform sampler2D accumTexture;
+layout(binding = 1) uniform sampler2D revealageTexture;
+
+out vec4 FragColor;
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float revealage = texelFetch(revealageTexture, pixel, 0).r;
+    if (revealage >= 1.0)
+        discard;    // no transparent surface here
+
+    vec4 accum = texelFetch(accumTexture, pixel, 0);
+    // weights can overflow half floats when many layers overlap
+    if (isinf(max(max(abs(accum.r), abs(accum.g)), abs(accum.b))))
+        accum.rgb = vec3(accum.a);
+
+    vec3 average = accum.rgb / max(accum.a, 1e-5);
+    FragColor = vec4(average, 1.0 - revealage);
+}
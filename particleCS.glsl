@@ -0,0 +1,90 @@
+#version 460 core
+layout (local_size_x = 256) in;
+
+// same rule as the CPU path in ParticleSystem.cpp: age, integrate, drop the dead, fade by remaining life
+
+struct Particle {
+    vec4 positionLife;  // xyz position, w remaining seconds
+    vec4 velocitySpan;  // xyz velocity, w total seconds
+    vec4 color;
+};
+
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+struct Material {
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+    float shininess;
+    int hasTexture;
+};
+
+struct Object {
+    mat4 model;
+    Material material;
+};
+
+layout(std430, binding = 3) readonly buffer ParticlesIn {
+    Particle particlesIn[];
+};
+
+layout(std430, binding = 4) writeonly buffer ParticlesOut {
+    Particle particlesOut[];
+};
+
+layout(std430, binding = 5) readonly buffer Spawns {
+    Particle spawns[];
+};
+
+// commands[source].instanceCount is the live count of particlesIn, the other one is appended to
+layout(std430, binding = 6) buffer DrawCommands {
+    DrawCommand commands[2];
+};
+
+layout(std430, binding = 7) writeonly buffer Objects {
+    Object objects[];
+};
+
+uniform float deltaTime;
+uniform int spawnCount;
+uniform int capacity;
+uniform int source;
+uniform vec4 specular;
+uniform float shininess;
+
+void append(Particle p) {
+    uint index = atomicAdd(commands[1 - source].instanceCount, 1u);
+    if (index >= uint(capacity)) {
+        atomicAdd(commands[1 - source].instanceCount, uint(-1));
+        return;
+    }
+
+    particlesOut[index] = p;
+
+    vec4 color = vec4(p.color.rgb, clamp(p.positionLife.w / p.velocitySpan.w, 0.0, 1.0));
+    mat4 model = mat4(1.0);
+    model[3] = vec4(p.positionLife.xyz, 1.0);
+    objects[index] = Object(model, Material(color, color, specular, shininess, 0));
+}
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+
+    if (i < commands[source].instanceCount) {
+        Particle p = particlesIn[i];
+        p.positionLife.w -= deltaTime;
+        if (p.positionLife.w > 0.0) {
+            p.positionLife.xyz += p.velocitySpan.xyz * deltaTime;
+            append(p);
+        }
+    }
+
+    if (i < uint(spawnCount))
+        append(spawns[i]);
+}